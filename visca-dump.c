@@ -5,23 +5,50 @@
  * as "receiver".
  *
  *
- * Compile: gcc -g -Wall -lezV24 -o visca-dump visca-dump.c
+ * Compile: gcc -g -Wall -o visca-dump visca-dump.c -lezV24 -lpthread -lm -lutil
  * Run:     ./visca-dump -r /dev/ttyUSB0 -s /dev/ttyUSB1
  * --------------------------------------------------------------------------
  */
 
+#define _GNU_SOURCE                     // O_DIRECT, fallocate()
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <unistd.h>
 #include <string.h>
+#include <stddef.h>
+#include <ctype.h>
 #include <signal.h>
 #include <time.h>
+#include <math.h>
 #include <sys/time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <pty.h>
 
 #include <ezV24/ezV24.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#include <cpuid.h>
+#define HAVE_TSC
+#endif
+
+#ifdef HAVE_LUA
+#include <lua.h>
+#include <lauxlib.h>
+#include <lualib.h>
+#endif
+
 
 
 /*+=========================================================================+*/
@@ -31,16 +58,180 @@
 #define VERSION                          "0.1"
 
 #define AVG_OUTLIER                      1000           // [ms]
+#define BLAME_LATE                       1000           // [ms] a span for later transactions
+#define TIMELINE_FRAMES                  64             // frames kept of the CAM line
 #define SZ_INTERFACE_NAME                10
 
+/* initialisation tracking: a stage taking longer than this is reported as slow
+ */
+#define INIT_SLOW_ADDRESS                500            // [ms]
+#define INIT_SLOW_IFCLEAR                500            // [ms]
+#define INIT_SLOW_POWER                  8000           // [ms]
+#define INIT_SLOW_INQUIRY                500            // [ms]
+
+/* group commands: the same command sent to several cameras within this window
+ */
+#define GROUP_WINDOW                     50             // [ms]
+#define GROUP_TIMEOUT                    10000          // [ms]
+#define MAX_GROUPS                       8              // groups tracked at once
+
+/* histograms: values below HIST_LINEAR have their own bucket, than each power
+ * of two is split into HIST_SUBBUCKETS buckets. The last bucket is the overflow
+ * (>= 4096ms).
+ */
+#define HIST_LINEAR                      8
+#define HIST_SUBBUCKETS                  4
+#define HIST_BUCKETS                     45
+
+/* interval statistics and the round robin store
+ */
+#define INTERVAL_LENGTH                  10             // [s]
+#define RRD_MAGIC                        "VDRRD06"
+#define RRD_HEADER_SIZE                  4096
+#define RRD_LEVELS                       4
+#define LINE_CTL                         0
+#define LINE_CAM                         1
+#define MAX_LINES                        2
+
+/* batch decoding and the benchmark
+ */
+#define BATCH_BLOCK                      256            // frames classified at once
+#define BENCH_FRAMES                     1000000
+#define BENCH_RECORDS                    2000000
+#define BENCH_FAULT_RATE                 0.001          // per packet and fault, if -N isn't used
+#define BENCH_REPEAT                     11             // runs of the framer, the fastest and the median cost count
+#define BENCH_REACTOR                    4              // [s] emulated traffic per loop
+#define BENCH_CTL_BURST                  9              // CTL packets back to back, then one idle
+#define BENCH_CAM_PERIOD                 25             // [ms] between the CAM packets
+#define BENCH_CAM_PACKETS                (BENCH_REACTOR*1000/BENCH_CAM_PERIOD+1)
+
+/* reading the ports
+ */
+#define REACTOR_TICK                     5              // [ms] poll() timeout for the timers
+#define REACTOR_READ                     256            // [bytes] read at once
+#define READER_WATERMARK                 1024           // [bytes] queued in the kernel, default of -Q
+#define READER_LAG_UNIT                  10             // [us] unit of the lag histogram (up to 40ms)
+
+/* capture files: records never cross a block. The rest of a block is padding.
+ */
+#define CAPTURE_MAGIC                    "VDCAP01"
+#define CAPTURE_BLOCK                    65536          // [bytes] multiple of the disk block
+#define CAPTURE_ALIGN                    4096           // alignment for O_DIRECT
+#define CAPTURE_PREALLOC                 (64L*1024L*1024L)
+#define CAPTURE_SYNC                     1              // [s] between fdatasync()
+#define CAPTURE_RING                     16             // staging buffers of the direct mode (1 MB)
+#define CAPTURE_WAIT                     100            // [ms] the capture thread waits at most for a buffer
+#define CAPTURE_PAD                      0              // line of the padding
+#define CAPTURE_PROXY                    0x01           // flags: answered by the proxy, not forwarded
+#define CAPTURE_INJECTED                 0x02           // flags: the reply of the proxy
+#define CAPTURE_OWN                      0x04           // flags: with CAPTURE_INJECTED, an inquiry of the proxy or its reply
+
+/* cached analysis of the capture blocks (-K)
+ */
+#define PARTIALS_MAGIC                   "VDPAR03"
+#define PARTIALS_SUFFIX                  ".vdc"
+#define ANALYSIS_VERSION                 1              // increment on changes of the analysis
+#define FNV_OFFSET                       0xcbf29ce484222325ULL
+#define FNV_PRIME                        0x100000001b3ULL
+#define PARTIAL_WORDS                    (sizeof(T_Interval)/sizeof(uint32_t))
+
+/* import of text logs written by dumpViscaPacket()
+ */
+#define IMPORT_MAX_THREADS               64
+#define IMPORT_MIN_CHUNK                 (1024L*1024L)  // [bytes] per thread at least
+#define IMPORT_HEX_COLUMN                20             // "HH:MM:SS[mmmm] CTL: "
+#define IMPORT_HEX_WORDS                 6              // VISCA_MAX_SIZE*3 chars
+#define IMPORT_MIN_LINE                  (IMPORT_HEX_COLUMN+VISCA_MAX_SIZE*3+1)
+#define IMPORT_ROLLOVER                  (12L*3600L*1000L)      // [ms] back in time
+#define IMPORT_WINDOW                    (256L*1024L*1024L)     // [bytes] parsed at once
+#define SWAR(c)                          (0x0101010101010101ULL*(uint8_t)(c))
+
+/* HTML report of a capture (-H)
+ */
+#define REPORT_MIN_BLOCKS                16             // capture blocks per thread at least
+#define REPORT_COLUMNS                   168            // time columns of the heatmaps (a week in hours)
+#define REPORT_SLOW                      20             // slowest transactions listed
+#define REPORT_CELL                      5              // [px] of a heatmap cell
+#define REPORT_LEFT                      50             // [px] left of the heatmap for the labels
+
+/* analysis scripts
+ */
+#define SCRIPT_QUEUE                     4096           // events (power of two)
+#define SCRIPT_BUDGET                    1000           // [us] CPU time per hook call
+#define SCRIPT_COUNT                     1000           // instructions between budget checks
+#define SCRIPT_IDLE                      1              // [ms] sleep if the queue is empty
+
 /* general VISCA definitions */
 #define VISCA_TERMINATOR                 0xFF
 #define VISCA_MIN_SIZE                   3
 #define VISCA_MAX_SIZE                   16
+#define VISCA_MAX_CAMERAS                7              // addresses 1..7
+#define VISCA_SOCKETS                    2              // command sockets 1..2
+#define VISCA_BROADCAST                  8              // address 8 is the broadcast
+#define VERSION_TIMEOUT                  1000           // [ms] for the injected VersionInq
+
+/* shadow camera in the proxy mode
+ */
+#define SHADOW_QUEUE                     256            // commands (power of two)
+#define SHADOW_POLL                      100            // [ms] reader checks for the end
+
+/* inquiry cache and prefetching in the proxy mode
+ */
+#define CACHE_ENTRIES                    16             // inquiries per camera
+#define PREFETCH_IDLE                    30             // [ms] both lines quiet
+#define PREFETCH_ACTIVE                  10000          // [ms] only inquiries polled within
+#define PREFETCH_TIMEOUT                 500            // [ms] for the reply
+#define PREFETCH_BURST                   100            // [ms] line time saved up at most
+#define PREFETCH_REPLY                   7              // [bytes] if the reply is unknown
+#define VISCA_BYTE_TIME                  1042           // [us] 10 bits at 9600 baud
+
+/* pacing of the commands in the proxy mode
+ */
+#define PACE_QUEUE                       8              // packets held per camera (power of two)
+#define PACE_TIMEOUT                     1000           // [ms] a command without reply is lost
+#define PACE_STUCK                       30000          // [ms] a socket without completion is lost
+#define PACE_SAMPLES                     20             // latencies needed for the p99
+#define PACE_WINDOW                      200            // latencies used for the p99 at most
+#define PACE_INCREASE                    0.1            // added to the limit per round trip
+
+/* timestamps from the TSC
+ */
+#define TSC_CALIBRATION                  20             // [ms] per calibration window at the start
+#define TSC_RECALIBRATE                  10             // [s] between the recalibrations
+#define TSC_MAX_DEVIATION                500            // [ppm] of the rate, else the TSC is unsuitable
+#define TSC_PAIR_TRIES                   16             // reads of a TSC/clock pair, the tightest counts
+#define TSC_MAX_SLEW                     500            // [ppm] of the rate to correct the time
+#define BENCH_CLOCKS                     5000000        // timestamps per clock
+#define BENCH_DRIFT                      2              // [s] without recalibration
+
+/* service level objectives (-O)
+ */
+#define SLO_MAX                          8              // objectives
+#define SLO_WINDOWS                      3              // see SloWindow
+#define SLO_RING                         (86400/INTERVAL_LENGTH)        // intervals of the longest window
+#define SLO_FAST_BURN                    14.4           // alert if both short windows burn faster
+
+/* latency hints for the controller software (-M)
+ */
+#define HINT_MAGIC                       "VDHNT01"
+#define HINT_WINDOW                      64             // transactions of the rolling percentiles
+#define HINT_NONE                        0xFFFF         // percentile without data
+#define HINT_READ_TRIES                  10000          // of readHint(), before the writer is given up
+#define BENCH_HINTS                      10000000       // reads of the hint table
+
+/* column templates of the packet lines (-T)
+ */
+#define RENDER_DEFAULT                   "%t %n: %h{%d}  - %c"
+#define RENDER_MAX_OPS                   32             // ops of a render plan
+#define RENDER_MAX_TEMPLATE              256            // characters of the literals
+#define RENDER_MAX_WIDTH                 64             // of a padded column
+#define RENDER_LINE                      2048           // bytes of a rendered line
+#define BENCH_RENDER                     1000000        // packets per formatter
 
 /* API error codes */
 #define VISCA_SUCCESS                    0x00
 #define VISCA_PENDING                    0x01
+#define VISCA_TRUNCATED                  0xFA   // cut by the header of the next packet
 #define VISCA_BAD_HEADER                 0xFB
 #define VISCA_OVERFLOW                   0xFC
 #define VISCA_TIMEDOUT                   0xFD
@@ -66,6 +257,9 @@
 /* ___________/  local macro declaration                        \___________ */
 /*            `-------------------------------------------------'            */
 
+/* a valid header: 81..88 of the controller, 90..F0 of the cameras */
+#define VISCA_IS_HEADER(b)  (((b) >= 0x81 && (b) <= 0x88) || ((b) >= 0x90 && ((b) & 0x0F) == 0))
+
 /*+=========================================================================+*/
 /*|                          LOCAL TYPEDECLARATIONS                         |*/
 /*`========================================================================='*/
@@ -100,11 +294,13 @@ enum COMMAND_SEQUENCE
     CMD_SetAdress,
     CMD_EXT_Turn,
     CMD_EXT_Pairing,
+    CMD_VersionInq,
 
     RPL_Address,
     RPL_Ack,
     RPL_Ack1,
     RPL_Ack2,
+    RPL_Version,
     RPL_Word,
     RPL_Byte,
     RPL_Done,
@@ -143,6 +339,19 @@ typedef struct tagVISCA_INTERFACE
     int type;
     struct timeval received;
 
+    // framing (see frameByte)
+    uint8_t frame[VISCA_MAX_SIZE];      // the packet being received
+    int pos;                            // bytes in `frame`
+    struct timeval start;               // first byte of `frame`
+
+    // load (see pollPorts)
+    struct timeval polled;              // last bytes read
+    long busy;                          // [us] CPU time of the reads and packets
+
+    // decoded header and sequence of the last valid packet
+    int cmd;                    // sequence id (see findCommand)
+    bool cached;                // answered by the proxy (cache or pacing)
+
     // Status:
     bool timedout;
     bool valid;
@@ -157,6 +366,666 @@ typedef struct tagAVARAGE
     long cnt;                   // number of packets received
 } T_Avarage;
 
+/* A transaction is a command sent by the controller and the replies of the
+ * camera. Until the ACK is received, it's "pending". After that it's bound to
+ * the socket reported by the camera.
+ */
+typedef struct tagTRANSACTION
+{
+    bool active;
+    int cmd;                    // sequence id of the command
+    uint8_t param;              // first parameter byte of the command
+    int group;                  // index of the command group or -1
+    struct timeval sent;        // timestamp of the command
+    struct timeval acked;       // timestamp of the ACK (if any)
+    int num;                    // size of the command
+    bool blocked;               // both sockets were in use when it was sent
+    struct timeval freed;       // a socket was freed after that (if any)
+} T_Transaction;
+
+/* The open transactions of a camera. A command waits for the ACK in
+ * `pending`, the ACK moves it into its socket until the completion. The
+ * replies are matched by trackReply() for the cameras, the shadow camera and
+ * the report, so all of them follow the same rules.
+ */
+enum TRACK_REPLY
+{
+    TRACK_None=0,               // no transaction matches
+    TRACK_Ack,                  // moved into its socket
+    TRACK_Done,                 // completed
+    TRACK_Failed                // failed by an error reply
+};
+
+typedef struct tagTRACK
+{
+    T_Transaction pending;      // command sent, waiting for the ACK
+    T_Transaction socket[VISCA_SOCKETS+1];      // index 0 is unused
+} T_Track;
+
+/* A frame on the CAM line. The line is busy from the first byte until
+ * num*VISCA_BYTE_TIME later.
+ */
+typedef struct tagFRAME
+{
+    struct timeval start;
+    int num;
+    int address;                // -1 for a bad packet
+} T_Frame;
+
+/* The latency of the transactions split into the reasons, see
+ * blameTransaction(). All values in [us].
+ */
+typedef struct tagBLAME
+{
+    uint32_t cnt;
+    uint64_t total;
+    uint64_t wire;              // the command itself on the line
+    uint64_t socket;            // waiting for a free socket
+    uint64_t line;              // behind frames of the same camera
+    uint64_t chain;             // behind frames of other cameras
+    uint64_t camera;            // the rest
+} T_Blame;
+
+/* Histogram of values in [ms]. Histograms can be merged by adding the buckets.
+ */
+typedef struct tagHISTOGRAM
+{
+    uint32_t bucket[HIST_BUCKETS];
+    uint32_t cnt;
+} T_Histogram;
+
+/* Interval statistics. All counters of an interval are collected here. The
+ * layout is used as slot of the round robin store too, so only fixed size
+ * types are used. Merging intervals means adding all counters.
+ */
+typedef struct tagINTERVAL_LINE
+{
+    uint32_t packets;
+    uint32_t bytes;
+    uint32_t errors;                    // bad packets
+    uint32_t unknown;                   // unknown sequences
+    uint32_t busy;                      // [us] CPU time spent on the line
+    uint32_t queued_max;                // [bytes] most bytes queued in the kernel at a wake-up
+    uint32_t alerts;                    // wake-ups with the queue above the watermark (-Q)
+    uint32_t lag_max;                   // [us] longest lag, beyond the histogram
+    T_Histogram queued;                 // [bytes] queued in the kernel at each wake-up
+    T_Histogram lag;                    // [READER_LAG_UNIT] wake-up -> read
+} T_IntervalLine;
+
+typedef struct tagINTERVAL_CAMERA
+{
+    uint16_t vendor;                    // model of the camera, 0 if unknown
+    uint16_t model;
+    uint16_t rom;
+    uint16_t limit;                     // lowest pacing limit*100, 0 if not paced
+    uint32_t transactions;
+    uint32_t errors;                    // transactions failed
+    T_Histogram ack;                    // command -> ACK
+    T_Histogram done;                   // command -> completion
+} T_IntervalCamera;
+
+typedef struct tagINTERVAL_COMMAND
+{
+    uint32_t cnt;
+    uint32_t errors;
+    T_Histogram done;                   // command -> completion
+} T_IntervalCommand;
+
+typedef struct tagINTERVAL_SLO
+{
+    uint32_t id;                        // hash of the definition, 0 is unused
+    uint32_t good;                      // transactions within the objective
+    uint32_t total;
+} T_IntervalSlo;
+
+typedef struct tagINTERVAL
+{
+    int64_t start;                      // [s] since the epoch, 0 means empty
+    uint32_t duration;                  // [s] covered by the data
+    uint32_t intervals;                 // number of merged intervals
+    T_IntervalLine line[MAX_LINES];
+    T_IntervalCamera cam[VISCA_MAX_CAMERAS+1];
+    T_IntervalCommand cmd[RPL_Address]; // index is the sequence id (0=unknown)
+    T_IntervalSlo slo[SLO_MAX];         // index is the objective (-O)
+} T_Interval;
+
+/* The round robin store is a memory mapped file. Each level is a ring of
+ * slots. A slot covers `step` seconds and each interval is merged into the
+ * slot of each level. So writes are O(1) and the size of the file is fixed.
+ */
+typedef struct tagRRD_LEVEL
+{
+    uint32_t step;                      // [s] covered by a slot
+    uint32_t slots;                     // number of slots in the ring
+    uint64_t offset;                    // file offset of the first slot
+} T_RrdLevel;
+
+typedef struct tagRRD_HEADER
+{
+    char magic[8];
+    uint32_t slot_size;                 // sizeof(T_Interval)
+    uint32_t levels;
+    T_RrdLevel level[RRD_LEVELS];
+    uint64_t id;                        // random, set at the creation (not part of the layout)
+} T_RrdHeader;
+
+/* Capture files. The file is a sequence of blocks with CAPTURE_BLOCK bytes.
+ * The first block starts with the file header. Each record is a packet
+ * (or a bad chunk of data) with a header and the raw bytes.
+ */
+typedef struct tagCAPTURE_HEADER
+{
+    char magic[8];
+    uint32_t block_size;
+    uint32_t reserved;
+} T_CaptureHeader;
+
+/* The analysis of a replayed capture can be cached in `<capture>.vdc`. Each
+ * block has an entry, in the order of the blocks. An entry holds the partial
+ * intervals of the block (the counters added by its packets) and the camera
+ * models known at its end. It's valid if the block and the block before are
+ * unchanged (FNV-1a hash) and the analysis has the same `config`. The header
+ * records the store the first `merged` blocks were merged into, and what was
+ * written for the interval still open at the end.
+ */
+typedef struct tagPARTIALS_HEADER
+{
+    char magic[8];
+    uint64_t config;                    // hash of the analysis version and layout
+    uint32_t block_size;
+    uint32_t blocks;                    // number of entries
+    uint64_t store;                     // id of the store (T_RrdHeader)
+    uint32_t merged;                    // blocks merged into the store
+    uint32_t open_duration;             // [s] written for the open interval
+    int64_t open_start;                 // the interval open at the end, 0 if none
+} T_PartialsHeader;
+
+typedef struct tagPARTIALS_ENTRY
+{
+    uint64_t hash;                      // of the block
+    uint64_t prev;                      // of the block before (0 for the first)
+    uint32_t partials;                  // number of intervals
+    uint32_t words;                     // packed words following (see packInterval)
+    uint16_t model[VISCA_MAX_CAMERAS+1][3];     // vendor, model, rom
+} T_PartialsEntry;
+
+typedef struct tagCAPTURE_RECORD
+{
+    uint8_t line;                       // LINE_CTL+1, LINE_CAM+1 or CAPTURE_PAD
+    uint8_t num;                        // number of bytes
+    uint8_t status;                     // return code of getViscaPacket()
+    uint8_t flags;                      // CAPTURE_PROXY, CAPTURE_INJECTED, CAPTURE_OWN
+    uint8_t usec[8];                    // [us] since the epoch (host byte order)
+} T_CaptureRecord;
+
+/* The capture writer. The capture thread copies the records into a staging
+ * buffer. A full buffer is written as block. In the "direct" mode, the file
+ * is preallocated and written with O_DIRECT by a background thread, using a
+ * ring of CAPTURE_RING staging buffers. The ring covers the fdatasync()
+ * stalls, so the capture thread doesn't wait for the disk. If the ring is
+ * full, it waits up to CAPTURE_WAIT ms for the writer, then records are
+ * dropped.
+ */
+typedef struct tagCAPTURE
+{
+    int fd;
+    bool direct;
+    uint8_t *buffer[CAPTURE_RING];      // staging buffers (aligned), 2 without the direct mode
+    int active;                         // buffer filled by the capture thread
+    size_t fill;                        // bytes used in the active buffer
+    uint64_t offset;                    // file offset of the next block
+    uint64_t allocated;                 // preallocated bytes
+    long dropped;                       // records dropped (writer busy)
+    long waits;                         // ring full, the capture thread waited
+    atomic_long blocks;                 // blocks written
+    atomic_long stall;                  // [us] longest fdatasync()
+    // background writer:
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int head;                           // next buffer to be written
+    int full;                           // buffers to be written
+    bool stop;
+    bool failed;
+} T_Capture;
+
+/* Text logs are imported in chunks, one per thread. A chunk starts at a line.
+ * The day of a record is counted within its chunk, the chunks are put in
+ * order before the records are written to the capture file.
+ */
+typedef struct tagIMPORT_RECORD
+{
+    uint32_t msec;                      // [ms] of the day
+    uint16_t day;                       // day rollovers in the chunk before
+    uint8_t line;                       // LINE_CTL or LINE_CAM
+    uint8_t status;                     // VISCA_SUCCESS or VISCA_FAILURE
+    uint8_t num;
+    uint8_t data[VISCA_MAX_SIZE];
+} T_ImportRecord;
+
+typedef struct tagIMPORT_CHUNK
+{
+    const char *start;
+    const char *end;
+    T_ImportRecord *rec;
+    size_t cnt;
+    uint32_t first;                     // [ms] of the day of the first record
+    uint32_t last;                      // [ms] of the day of the last record
+    uint16_t days;                      // rollovers in the chunk
+    uint16_t base;                      // day of the chunk start
+    long other;                         // no packet (statistics, spans, ...)
+    long bad;                           // packet lines which can't be parsed
+    pthread_t thread;
+} T_ImportChunk;
+
+/* The HTML report (-H) is built from the blocks of a capture in parallel.
+ * Each thread analyses a range of blocks. It replays the block before its
+ * range first without counting, so the transactions open at the start of the
+ * range are known, and counts the transactions completed within its range.
+ * The packets of a block are decoded at once by findCommands(). The reports
+ * of the threads are merged by adding, like the intervals.
+ */
+typedef struct tagREPORT_SLOW
+{
+    int64_t sent;                       // [us] since the epoch
+    int64_t latency;                    // [us] command -> completion
+    int64_t ack;                        // [us] command -> ACK, -1 without ACK
+    int16_t cmd;
+    int8_t address;
+} T_ReportSlow;
+
+typedef struct tagREPORT
+{
+    T_IntervalLine line[MAX_LINES];
+    T_IntervalCamera cam[VISCA_MAX_CAMERAS+1];                  // 0 is all cameras
+    T_IntervalCommand cmd[RPL_Address];
+    T_Histogram heat[VISCA_MAX_CAMERAS+1][REPORT_COLUMNS];      // completion by time
+    uint64_t busy[VISCA_MAX_CAMERAS+1][VISCA_SOCKETS+1];        // [us] ACK -> completion
+    uint32_t sent[VISCA_MAX_CAMERAS+1];                         // controller packets
+    uint32_t polls[VISCA_MAX_CAMERAS+1];                        // inquiries among them
+    uint64_t poll_bytes;
+    uint32_t codes[256];                                        // error replies by code
+    T_ReportSlow slow[REPORT_SLOW];                             // unordered
+    int slows;
+    uint64_t slo_good[SLO_MAX];                                 // by objective (-O)
+    uint64_t slo_total[SLO_MAX];
+} T_Report;
+
+typedef struct tagREPORT_CHUNK
+{
+    const uint8_t *data;                // the mapped capture
+    uint32_t warm;                      // block replayed without counting
+    uint32_t first;                     // blocks counted: first..last-1
+    uint32_t last;
+    int64_t from;                       // [us] packets before aren't counted
+    int64_t start;                      // [us] first column of the heatmaps
+    int64_t span;                       // [us] covered by the heatmaps
+    T_Report *rep;
+    T_Track track[VISCA_MAX_CAMERAS+1];                         // see trackReply()
+    // the records of a block, see reportBlock()
+    uint32_t offset[CAPTURE_BLOCK/sizeof(T_CaptureRecord)];
+    uint8_t length[CAPTURE_BLOCK/sizeof(T_CaptureRecord)];
+    uint8_t line[CAPTURE_BLOCK/sizeof(T_CaptureRecord)];
+    uint8_t status[CAPTURE_BLOCK/sizeof(T_CaptureRecord)];
+    uint8_t flags[CAPTURE_BLOCK/sizeof(T_CaptureRecord)];
+    int64_t usec[CAPTURE_BLOCK/sizeof(T_CaptureRecord)];
+    int16_t id[CAPTURE_BLOCK/sizeof(T_CaptureRecord)];
+    uint8_t address[CAPTURE_BLOCK/sizeof(T_CaptureRecord)];
+    uint8_t sock[CAPTURE_BLOCK/sizeof(T_CaptureRecord)];
+    uint32_t param[CAPTURE_BLOCK/sizeof(T_CaptureRecord)];
+    long packets;
+    pthread_t thread;
+} T_ReportChunk;
+
+/* Faults injected into the packets by the framer benchmark (-B, -N).
+ */
+enum FAULT_TYPE
+{
+    FAULT_Flip=0,               // a bit of a byte is flipped
+    FAULT_Drop,                 // a byte is lost
+    FAULT_Spurious,             // a random byte is inserted
+    FAULT_Truncate,             // the end of the packet is lost
+    FAULT_Gap,                  // a timeout within the packet
+    FAULT_MAX_TYPES
+};
+
+typedef struct tagBENCH_STREAM
+{
+    int16_t *stream;                    // bytes, -1 is a timeout
+    size_t n;
+    uint32_t *start;                    // first and last byte of the intact packets
+    uint32_t *end;
+    uint32_t *id;                       // index of the intact packet
+    size_t intact;
+    uint32_t *fault;                    // first byte of the damaged packets
+    size_t faults;
+} T_BenchStream;
+
+/* Emulated lines of the reactor benchmark. The writer thread sends the bytes
+ * at 9600 baud into the master side of two ptys.
+ */
+typedef struct tagBENCH_REACTOR
+{
+    int ctl;                            // master side of the ptys
+    int cam;
+    struct timeval written[BENCH_CAM_PACKETS];  // before the last byte of a CAM packet
+    int handled;                        // CAM packets handled
+    T_Histogram delay;                  // [us/10] last byte -> handled
+    long max;                           // [us]
+    atomic_bool stop;
+} T_BenchReactor;
+
+/* Events passed to the analysis script. The capture thread writes them into
+ * a queue, the script thread reads them. The script gets read only access to
+ * the queued event, nothing is copied.
+ */
+enum SCRIPT_EVENT
+{
+    SCRIPT_Packet=0,
+    SCRIPT_Transaction,
+    SCRIPT_Interval,
+    SCRIPT_MAX_EVENTS
+};
+
+typedef struct tagSCRIPT_EVENT
+{
+    uint8_t type;                       // SCRIPT_xxx
+    uint8_t line;                       // packet: LINE_CTL or LINE_CAM
+    uint8_t num;                        // packet: number of bytes
+    uint8_t status;                     // packet: return code of getViscaPacket()
+    int16_t cmd;                        // packet, transaction: sequence id
+    int8_t address;                     // packet, transaction
+    bool failed;                        // transaction
+    struct timeval tick;                // packet: received, transaction: sent, interval: start
+    uint8_t data[VISCA_MAX_SIZE];       // packet
+    long latency;                       // transaction: command -> completion [ms]
+    long ack;                           // transaction: command -> ACK [ms] or -1
+    uint32_t packets[MAX_LINES];        // interval
+    uint32_t errors[MAX_LINES];         // interval
+    uint32_t transactions;              // interval
+    double slo_burn;                    // interval: highest burn rate (1h)
+    double slo_budget;                  // interval: lowest error budget left [%]
+} T_ScriptEvent;
+
+/* A group is the same command sent to several cameras (or as broadcast) in a
+ * short window. It's complete if the last member transaction is finished.
+ */
+typedef struct tagGROUP
+{
+    bool active;
+    bool broadcast;
+    bool failed;
+    uint8_t data[VISCA_MAX_SIZE];       // command without the header
+    int num;
+    unsigned members;                   // bit mask of the camera addresses
+    int cnt;                            // number of members
+    int outstanding;                    // unfinished member transactions
+    struct timeval start;               // first command of the group
+    struct timeval first;               // first finished member
+    struct timeval last;                // last finished member
+} T_Group;
+
+/* Stages of the initialisation sequence of a camera chain
+ */
+enum INIT_STAGE
+{
+    INIT_Address=0,             // AddressSet broadcast -> address reply
+    INIT_IfClear,               // IfClear -> reply
+    INIT_Power,                 // Power on -> Done
+    INIT_Inquiry,               // first successful inquiry
+    INIT_MAX_STAGES
+};
+
+typedef struct tagINIT_STAGE
+{
+    long duration;              // [ms] or -1 if not finished
+    bool slow;
+    bool failed;
+} T_InitStage;
+
+/* Per camera data. The index of the array is the VISCA address.
+ */
+typedef struct tagCAMERA
+{
+    bool present;               // any packet seen from/to this address
+    T_Track track;              // open transactions
+
+    // initialisation / readiness
+    T_InitStage init[INIT_MAX_STAGES];
+    long ready;                 // [ms] since start of the chain or -1
+
+    // model and firmware (CAM_VersionInq)
+    bool version;               // the version is known
+    bool injected;              // VersionInq was sent by the proxy
+    struct timeval asked;       // timestamp of the injected VersionInq
+    uint16_t vendor;
+    uint16_t model;
+    uint16_t rom;
+    uint8_t sockets;
+} T_Camera;
+
+/* In the proxy mode, each controller packet can be copied to a shadow camera.
+ * The packets are queued for the shadow thread, which writes them to the
+ * shadow port and tracks the replies in its own cameras. The results per
+ * command are compared with the ones of the primary cameras.
+ */
+typedef struct tagSHADOW_COMMAND
+{
+    uint8_t data[VISCA_MAX_SIZE];       // the packet of the controller
+    uint8_t num;
+    bool track;                         // a command to be tracked
+    int16_t cmd;
+    int8_t address;                     // 0 is the broadcast
+    struct timeval sent;
+    struct timespec queued;             // CLOCK_MONOTONIC
+} T_ShadowCommand;
+
+typedef struct tagSHADOW
+{
+    T_Camera cam[VISCA_MAX_CAMERAS+1];  // transactions of the shadow camera
+    T_IntervalCommand cmd[RPL_Address];
+    long packets;
+    long errors;                        // bad packets
+    long lost;                          // commands without a reply
+} T_Shadow;
+
+/* A cached reply to an inquiry. The cache of a camera is cleared by each
+ * command sent to it, so only values not changed by the controller are used.
+ */
+typedef struct tagCACHE_ENTRY
+{
+    int cmd;                            // sequence id, 0 is unused
+    uint8_t request[VISCA_MAX_SIZE];
+    int request_num;
+    uint8_t reply[VISCA_MAX_SIZE];
+    int reply_num;
+    struct timeval stored;              // the reply was received, 0 is none
+    struct timeval asked;               // last inquiry of the controller
+    bool prefetched;                    // stored by a prefetch and not used yet
+} T_CacheEntry;
+
+/* The pacing of a camera. The proxy holds the commands of the controller, so
+ * not more than `limit` commands are open at once. The limit is adjusted by
+ * paceFeedback(): it grows with each reply below the latency ceiling and is
+ * halved on congestion (buffer full, lost reply, p99 above the ceiling).
+ */
+typedef struct tagPACE_PACKET
+{
+    uint8_t buffer[VISCA_MAX_SIZE];
+    int num;
+    int type;
+    int address;
+    int cmd;
+    struct timeval received;
+} T_PacePacket;
+
+typedef struct tagPACE
+{
+    double limit;                       // commands in flight, 1..sockets
+    uint16_t low;                       // lowest limit*100 of the interval
+    T_PacePacket queue[PACE_QUEUE];
+    unsigned head;
+    unsigned tail;
+    T_Histogram latency;                // [ms] ACK or inquiry reply, since the last change
+    T_Histogram wait;                   // [ms] packets held
+    struct timeval decreased;           // last halving of the limit
+    long held;
+    long rejected;                      // queue was full
+    long decreases;
+} T_Pace;
+
+/* The TSC as clock. The rate is calibrated against CLOCK_MONOTONIC, the
+ * time is anchored to CLOCK_REALTIME. Each recalibration measures the rate
+ * over the time since the last one and moves the anchor to the time the
+ * clock shows, so it never steps back. The offset to CLOCK_REALTIME is slewed
+ * away until the next recalibration by a slightly changed rate in `mult`.
+ * The main thread calibrates, getTime() is called by the shadow thread too.
+ * So the anchor is changed with a seqlock like the latency hints.
+ */
+typedef struct tagTSC_CLOCK
+{
+    atomic_uint seq;                    // odd while the anchor is changed
+    bool valid;                         // the TSC is used, else gettimeofday()
+    double ns_per_tick;                 // measured rate
+    uint64_t mult;                      // slewed ns_per_tick << 32
+    uint64_t tsc;                       // at the anchor
+    int64_t mono;                       // [ns] CLOCK_MONOTONIC at the anchor
+    int64_t real;                       // [ns] time of the clock at the anchor
+    time_t next;                        // [s] next recalibration
+    long calibrations;
+    int64_t drift;                      // [ns] largest error found by a recalibration
+    int64_t offset;                     // [ns] largest offset to CLOCK_REALTIME
+} T_TscClock;
+
+/* Classes of commands of a service level objective.
+ */
+enum SLO_CLASS
+{
+    SLO_Command=0,              // a single command, see `cmd`
+    SLO_All,                    // all transactions
+    SLO_Commands,               // all but the inquiries
+    SLO_Inquiries,
+    SLO_Stops,                  // Zoom, Focus or EXT_Turn with "stop"
+    SLO_MAX_CLASSES
+};
+
+/* A service level objective (-O), e.g. `stop@1:ack:p99<50`: 99% of the stop
+ * commands sent to camera 1 are acknowledged within 50ms. The transactions
+ * are counted in the intervals. A ring of the intervals of the longest window
+ * keeps the sums of each window, so an interval costs the same for any
+ * traffic.
+ */
+typedef struct tagSLO
+{
+    char spec[48];                      // as given
+    uint32_t id;                        // hash of `spec`
+    int cls;                            // SLO_xxx
+    int cmd;                            // sequence id of SLO_Command
+    int address;                        // camera, 0 is any
+    bool ack;                           // command -> ACK (else -> completion)
+    double objective;                   // share of the good transactions
+    long threshold;                     // [ms]
+    uint32_t *good;                     // ring of SLO_RING intervals
+    uint32_t *total;
+    uint32_t head;                      // intervals pushed
+    int64_t last;                       // start of the last interval pushed
+    uint64_t sum_good[SLO_WINDOWS];     // sums of the windows
+    uint64_t sum_total[SLO_WINDOWS];
+    bool alert;                         // both short windows burn too fast
+} T_Slo;
+
+/* The latency hints (-M) are a table in a shared memory file, readable by
+ * other processes. Each camera has a record of a cache line. It's written
+ * with a seqlock: `seq` is odd while the record is changed. A reader copies
+ * the record and retries if `seq` was odd or changed meanwhile (see
+ * readHint). The layout is fixed, all times in [ms].
+ */
+enum HINT_CLASS
+{
+    HINT_Commands=0,            // all but the inquiries and stops
+    HINT_Inquiries,
+    HINT_Stops,                 // Zoom, Focus or EXT_Turn with "stop"
+    HINT_MAX_CLASSES
+};
+
+typedef struct tagHINT_CAMERA
+{
+    atomic_uint seq;                    // odd while written
+    uint16_t ack_p50[HINT_MAX_CLASSES]; // command -> ACK (or reply), HINT_NONE without data
+    uint16_t ack_p99[HINT_MAX_CLASSES];
+    uint16_t done_p50[HINT_MAX_CLASSES];        // command -> completion
+    uint16_t done_p99[HINT_MAX_CLASSES];
+    uint8_t sockets;                    // bit n: socket n busy, bit 0: a command waits for the ACK
+    uint8_t busy;                       // number of busy sockets
+    uint16_t errors;                    // [1/10000] of the last HINT_WINDOW transactions failed
+    uint32_t transactions;              // completed since the start
+    int64_t updated;                    // [us] since the epoch
+    uint8_t reserved[16];               // a record fills a cache line
+} T_HintCamera;
+_Static_assert(sizeof(T_HintCamera) == 64,"a record of the hint table must fill a cache line");
+
+typedef struct tagHINT_TABLE
+{
+    char magic[8];                      // HINT_MAGIC, written last
+    uint32_t size;                      // sizeof(T_HintTable)
+    uint32_t record;                    // sizeof(T_HintCamera)
+    uint32_t cameras;                   // records following the header - 1 (cam[0] is unused)
+    uint32_t classes;                   // HINT_MAX_CLASSES
+    uint32_t window;                    // HINT_WINDOW
+    uint32_t pid;                       // of the writer, 0 if stopped
+    uint8_t reserved[32];
+    T_HintCamera cam[VISCA_MAX_CAMERAS+1];
+} T_HintTable;
+
+/* A rolling window of the last HINT_WINDOW values as histogram. The bucket
+ * of each value is kept, so it can be removed again.
+ */
+typedef struct tagHINT_WINDOW
+{
+    T_Histogram hist;
+    uint8_t ring[HINT_WINDOW];          // bucket of each value
+    uint32_t head;                      // values added
+} T_HintWindow;
+
+/* The columns of a packet line (-T). A template like `%t %n: %h` is compiled
+ * once into a plan of ops, each writes a column of known maximum width, so
+ * rendering a packet doesn't parse a format string.
+ */
+enum RENDER_OP
+{
+    RENDER_Literal=0,           // text of the template
+    RENDER_Time,                // %t HH:MM:SS[mmmm]
+    RENDER_Epoch,               // %e seconds.microseconds
+    RENDER_Name,                // %n interface name
+    RENDER_Hex,                 // %h packet as hex, padded to VISCA_MAX_SIZE bytes
+    RENDER_Raw,                 // %x packet as hex
+    RENDER_Length,              // %l packet length
+    RENDER_Address,             // %a camera address, `*' is broadcast
+    RENDER_Socket,              // %s socket
+    RENDER_Param,               // %p parameter (see decodeParameter)
+    RENDER_Reply,               // %d reply time and avarage
+    RENDER_Command,             // %c name of the command
+    RENDER_MAX_TYPES
+};
+
+typedef struct tagRENDER_OPERATION
+{
+    uint8_t op;                         // RENDER_xxx
+    uint8_t width;                      // pad to `width` columns, 0 is none
+    uint16_t from;                      // literal: offset in `text`
+    uint16_t len;                       //          and length
+} T_RenderOp;
+
+typedef struct tagRENDER_PLAN
+{
+    T_RenderOp op[RENDER_MAX_OPS];
+    int cnt;
+    char text[RENDER_MAX_TEMPLATE];     // the literals
+    time_t second;                      // `clock` is valid for this second
+    char clock[8];                      // HH:MM:SS
+    bool local;                         // localtime() of `second` succeeded
+} T_RenderPlan;
+
 
 
 
@@ -177,6 +1046,67 @@ static T_VISCAInterface receiver;
 static T_Avarage avg_ack   = {0.0L,0.0L,0L};
 static T_Avarage avg_done  = {0.0L,0.0L,0L};
 
+static T_Camera cameras[VISCA_MAX_CAMERAS+1];
+
+/* latency attribution: the last frames of the CAM line and the blame per
+ * command and camera
+ */
+static T_Frame Timeline[TIMELINE_FRAMES];
+static unsigned TimelineHead = 0;
+static T_Blame BlameCmd[RPL_Address];
+static T_Blame BlameCam[VISCA_MAX_CAMERAS+1];
+
+/* chain wide initialisation tracking
+ */
+static struct timeval ChainStart;       // timestamp of the AddressSet broadcast
+static bool ChainStarted = false;
+static int ChainSize = 0;               // cameras reported by the address reply
+static long ChainReady = -1;            // [ms] since start of the chain
+static int InitSlow = 0;                // number of slow stages
+static int InitFailed = 0;              // number of failed stages
+
+static const char* InitStageNames[INIT_MAX_STAGES] =
+{
+    "address", "ifclear", "power", "inquiry"
+};
+static const long InitSlowLimit[INIT_MAX_STAGES] =
+{
+    INIT_SLOW_ADDRESS, INIT_SLOW_IFCLEAR, INIT_SLOW_POWER, INIT_SLOW_INQUIRY
+};
+
+/* command groups
+ */
+static T_Group groups[MAX_GROUPS];
+static int GroupNext = 0;               // next slot used for a new group
+static int GroupOpen = -1;              // group accepting new members or -1
+static long GroupCnt = 0;               // completed groups
+static long GroupFailed = 0;            // groups with a failed member
+static long GroupLost = 0;              // groups never completed
+static T_Histogram GroupCompletion;     // first command -> last completion
+static T_Histogram GroupSpread;         // first -> last completion of the members
+
+/* interval statistics and the store
+ */
+static T_Interval Interval;             // the current interval
+static T_IntervalLine LoadLast[MAX_LINES];      // the last interval
+static long LoadBusy[MAX_LINES];        // [us] busy at the start of the interval
+static long ReaderWatermark = READER_WATERMARK; // [bytes] queued, see -Q
+static char RrdFileName[FILENAME_MAX] = {'\0'};
+static long RrdQuery = 0;               // [s] to query from the store or 0
+static uint8_t *Rrd = NULL;             // mapped store
+static size_t RrdSize = 0;
+
+/* the consolidation levels: 10s for 1h, 1min for 1 day, 1h for 90 days, 1 day
+ * for 2 years.
+ */
+static const T_RrdLevel RrdLayout[RRD_LEVELS] =
+{
+    { 10,     360, 0 },
+    { 60,    1440, 0 },
+    { 3600,  2160, 0 },
+    { 86400,  730, 0 }
+};
+
 static unsigned int MyOpenFlags = V24_STANDARD;
 static int MyTimeOut = 0;
 
@@ -208,10 +1138,12 @@ static T_VISCA_Sequence sequences[CMD_MAX_SEQUENCES+1] =
     {{0x30, 0x01},             2, 2},  // CMD_SetAdress        | Adressvergabe. (normalerweise Broadcast mit 88)
     {{0x77, 0x01},             3, 2},  // CMD_EXT_Turn         | dir: 0=stop 1=left 2=right
     {{0x77, 0x02},             2, 2},  // CMD_EXT_Pairing      |
-    {{0x30, 0x02},             2, 2},  // RPL_Address          | SOP=0x90
+    {{0x09, 0x00, 0x02},       3, 3},  // CMD_VersionInq       |
+    {{0x30, 0x02},             2, 1},  // RPL_Address          | SOP=0x88  0x02..0x08 (number of cameras+1)
     {{0x40},                   1, 1},  // RPL_Ack              | SOP=0x90
     {{0x41},                   1, 1},  // RPL_Ack1             | SOP=0x90
     {{0x42},                   1, 1},  // RPL_Ack2             | SOP=0x90
+    {{0x50},                   8, 1},  // RPL_Version          | SOP=0x90  vendor(2) model(2) rom(2) sockets(1)
     {{0x50},                   5, 1},  // RPL_Word             | SOP=0x90
     {{0x50},                   2, 1},  // RPL_Byte             | SOP=0x90
     {{0x50},                   1, 1},  // RPL_Done             | SOP=0x90
@@ -224,6 +1156,173 @@ static T_VISCA_Sequence sequences[CMD_MAX_SEQUENCES+1] =
     {{0x00},0,0}
 };
 
+/* The sequences as packed keys for the batch decoding. The bytes 1..4 of a
+ * packet are loaded as little endian 32bit value. `SequenceMask` selects the
+ * comparable bytes. Build by prepareSequences().
+ */
+static uint32_t SequenceKey[CMD_MAX_SEQUENCES];
+static uint32_t SequenceMask[CMD_MAX_SEQUENCES];
+static uint8_t SequenceLength[CMD_MAX_SEQUENCES];       // packet length
+static bool SequencesPrepared = false;
+
+static bool Benchmark = false;          // run the benchmarks (-B)
+static double FaultRate[FAULT_MAX_TYPES] =      // per packet (-N)
+{
+    BENCH_FAULT_RATE, BENCH_FAULT_RATE, BENCH_FAULT_RATE, BENCH_FAULT_RATE, BENCH_FAULT_RATE
+};
+static const char* FaultNames[FAULT_MAX_TYPES] =
+{
+    "flip", "drop", "spurious", "truncate", "gap"
+};
+
+/* proxy mode
+ */
+static bool Proxy = false;              // forward the packets (-P)
+static bool AskVersion = false;         // inject CAM_VersionInq (-V)
+static T_VISCAInterface injected;       // packets sent by the proxy itself
+static T_BenchReactor *BenchLines = NULL;
+
+/* shadow camera: ShadowStats, ShadowTee and ShadowFailed are owned by the
+ * shadow thread and read with ShadowLock held. The other variables belong to
+ * the main thread.
+ */
+static char ShadowPortName[V24_SZ_PORTNAME+1] = {'\0'};
+static T_VISCAInterface shadow;
+static T_Shadow ShadowStats;
+static T_ShadowCommand ShadowQueue[SHADOW_QUEUE];
+static atomic_uint ShadowHead;                  // written by the main thread
+static atomic_uint ShadowTail;                  // written by the reader thread
+static atomic_bool ShadowStop;
+static pthread_t ShadowThread;
+static pthread_mutex_t ShadowLock = PTHREAD_MUTEX_INITIALIZER;
+static T_IntervalCommand ShadowPrimary[RPL_Address];   // same period as ShadowStats
+static int ShadowWake[2] = { -1, -1 };          // pipe, wakes the shadow thread
+static T_Histogram ShadowTee;                   // [us] queued -> written
+static long ShadowTeeMax;                       // [us]
+static long ShadowDropped;                      // queue was full
+static long ShadowFailed;                       // write failed
+
+/* inquiry cache and prefetching
+ */
+static long CacheTTL = 0;                       // [ms] -C, 0 is off
+static long PrefetchCap = 0;                    // [%] of the line time, -F
+static T_CacheEntry InquiryCache[VISCA_MAX_CAMERAS+1][CACHE_ENTRIES];
+static struct timeval LastTraffic;              // last packet on any line
+static int PrefetchCam = 0;                     // camera of the open prefetch
+static T_CacheEntry *PrefetchEntry = NULL;
+static struct timeval PrefetchSent;
+static struct timeval PrefetchStart;            // start of the line time
+static struct timeval PrefetchLast;             // last credit update
+static long PrefetchCredit = 0;                 // [us/100] line time to use
+static long PrefetchLine = 0;                   // [us] line time used
+static long CacheAsks = 0;
+static long CacheHits = 0;
+static long PrefetchCnt = 0;
+static long PrefetchUsed = 0;                   // a hit on a prefetched reply
+static long PrefetchPreempted = 0;              // controller packet while open
+static long PrefetchLost = 0;                   // no reply
+
+/* pacing of the commands
+ */
+static long PaceCeiling = 0;                    // [ms] p99 latency, -L, 0 is off
+static T_Pace Pace[VISCA_MAX_CAMERAS+1];
+
+/* timestamps
+ */
+static T_TscClock Tsc;
+
+/* service level objectives
+ */
+static T_Slo Slo[SLO_MAX];
+static int SloCount = 0;
+static const long SloWindow[SLO_WINDOWS] = { 300, 3600, 86400 };      // [s]
+static const char* SloWindowNames[SLO_WINDOWS] = { "5m", "1h", "24h" };
+static const char* SloClassNames[SLO_MAX_CLASSES] =
+{
+    "", "all", "cmd", "inq", "stop"
+};
+
+/* latency hints (-M)
+ */
+static char HintFileName[FILENAME_MAX] = {'\0'};
+static T_HintTable *Hints = NULL;               // mapped table
+static T_HintWindow HintAck[VISCA_MAX_CAMERAS+1][HINT_MAX_CLASSES];
+static T_HintWindow HintDone[VISCA_MAX_CAMERAS+1][HINT_MAX_CLASSES];
+static bool HintFailed[VISCA_MAX_CAMERAS+1][HINT_WINDOW];
+static uint32_t HintCount[VISCA_MAX_CAMERAS+1];         // transactions completed
+static atomic_bool HintBenchStop;               // ends benchHintWriter()
+
+/* column template (-T)
+ */
+static T_RenderPlan Render;
+static const char RenderLetters[] = " tenhxlaspdc";         // by RENDER_xxx
+static const char RenderHex[] = "0123456789ABCDEF";
+
+/* capture and replay
+ */
+static char CaptureFileName[FILENAME_MAX] = {'\0'};
+static bool CaptureDirect = false;      // -W
+static T_Capture *Capture = NULL;
+static char ReplayFileName[FILENAME_MAX] = {'\0'};
+static bool ReplayCache = false;        // -K
+static bool Quiet = false;              // no output of the packets, see replayBlock()
+static T_Interval *Partials = NULL;     // intervals of the current block, if cached
+static uint32_t PartialsCount = 0;
+static uint32_t PartialsMax = 0;
+static uint32_t *Packed = NULL;         // the partials packed for the cache
+static uint32_t PackedMax = 0;          // [words]
+static T_Interval Merged;               // the interval written next, see mergePartial()
+
+/* HTML report (-H)
+ */
+static char ReportFileName[FILENAME_MAX] = {'\0'};
+
+/* import of text logs: the expected flags of the hex column for each packet
+ * length, one bit (0x80) per character
+ */
+static char ImportFileName[FILENAME_MAX] = {'\0'};
+static char ImportDate[11] = {'\0'};                    // YYYY-MM-DD (-d)
+static uint64_t ImportHex[VISCA_MAX_SIZE+1][IMPORT_HEX_WORDS];
+static uint64_t ImportSpace[VISCA_MAX_SIZE+1][IMPORT_HEX_WORDS];
+
+/* analysis script
+ */
+static char ScriptFileName[FILENAME_MAX] = {'\0'};
+static long ScriptBudget[SCRIPT_MAX_EVENTS] =   // [us] per hook call
+{
+    SCRIPT_BUDGET, SCRIPT_BUDGET, SCRIPT_BUDGET
+};
+static const char* ScriptEventNames[SCRIPT_MAX_EVENTS] =
+{
+    "packet", "transaction", "interval"
+};
+#ifdef HAVE_LUA
+static lua_State *Script = NULL;
+static T_ScriptEvent *ScriptQueue = NULL;
+static atomic_uint ScriptHead;                  // written by the capture thread
+static atomic_uint ScriptTail;                  // written by the script thread
+static atomic_bool ScriptStop;
+static pthread_t ScriptThread;
+static const T_ScriptEvent *ScriptCurrent;      // event passed to the hook
+static struct timespec ScriptDeadline;          // CPU time of the script thread
+static const char* ScriptHooks[SCRIPT_MAX_EVENTS] =
+{
+    "on_packet", "on_transaction", "on_interval"
+};
+static bool ScriptHasHook[SCRIPT_MAX_EVENTS];
+#endif
+static long ScriptDropped[SCRIPT_MAX_EVENTS];   // queue was full
+static atomic_long ScriptOverrun[SCRIPT_MAX_EVENTS];    // budget exceeded (script thread)
+static atomic_long ScriptFailed[SCRIPT_MAX_EVENTS];     // other script errors (script thread)
+
+/* state of the packet processing
+ */
+static volatile sig_atomic_t Terminate = 0;
+static bool WaitResponse = false;
+static long SenderErrors = 0;
+static long ReceiverErrors = 0;
+static int Dumps = 0;
+
 /* Sequence names (index returned by findCommand is used)
  */
 static const char* SequenceNames[CMD_MAX_SEQUENCES+1] =
@@ -253,10 +1352,12 @@ static const char* SequenceNames[CMD_MAX_SEQUENCES+1] =
     "CMD: SetAdress",          // CMD_SetAdress        | Adressvergabe. (normalerweise Broadcast mit 88)
     "CMD: EXT_Turn",           // CMD_EXT_Turn         | dir: 0=stop 1=left 2=right
     "CMD: EXT_Pairing",        // CMD_EXT_Pairing      |
+    "CMD: VersionInq",         // CMD_VersionInq       |
     "RPL: Address",            // RPL_Address          |
     "RPL: Ack",                // RPL_Ack              |
     "RPL: Ack Sock1",          // RPL_Ack1             |
     "RPL: Ack Sock2",          // RPL_Ack2             |
+    "RPL: Version",            // RPL_Version          |
     "RPL: Word",               // RPL_Word             |
     "RPL: Byte",               // RPL_Byte             |
     "RPL: Done",               // RPL_Done             |
@@ -274,12 +1375,172 @@ static const char* SequenceNames[CMD_MAX_SEQUENCES+1] =
 /*`========================================================================='*/
 
 void dumpPacketStreams ( void );
+void processPacket ( T_VISCAInterface *interface, uint8_t rc );
 void dumpViscaPacket ( T_VISCAInterface *interface, long int diff );
 void dumpBadPacket ( T_VISCAInterface *interface );
+static bool compileTemplate ( T_RenderPlan *plan, const char *spec );
+static size_t renderPacket ( T_RenderPlan *plan, char *line, const T_VISCAInterface *interface, long int diff );
+static char *renderTime ( T_RenderPlan *plan, char *p, const struct timeval *tick );
+static char *renderReply ( char *p, long int diff, long double avg, char type );
+static char *renderNumber ( char *p, unsigned long value, int digits );
 void dumpErrorMessage ( int rc );
 
 static uint8_t getViscaPacket ( T_VISCAInterface *interface );
+static uint8_t finishPacket ( T_VISCAInterface *interface, uint8_t rc );
+static void pollPorts ( T_VISCAInterface **ports, int n, void (*handle)( T_VISCAInterface *, uint8_t ), int timeout );
+static void handlePacket ( T_VISCAInterface *interface, uint8_t rc );
+static uint8_t frameByte ( T_VISCAInterface *interface, int byte );
+static uint8_t decodePacket ( T_VISCAInterface *interface );
+static T_Capture *openCapture ( const char *FileName, bool direct );
+static void writeCapture ( T_Capture *cap, int line, uint8_t status, const struct timeval *tick, const uint8_t *data, int num,
+                           uint8_t flags );
+static void closeCapture ( T_Capture *cap );
+static void flushCapture ( T_Capture *cap );
+static void freeCapture ( T_Capture *cap );
+static void *captureWriter ( void *arg );
+static bool replayCapture ( const char *FileName );
+static bool replayBlock ( const uint8_t *block, size_t pos, bool quiet );
+static bool replayCached ( const char *FileName );
+static void addPartial ( const T_Interval *interval );
+static T_Interval *newPartial ( void );
+static void mergePartial ( const T_Interval *interval );
+static bool readPartials ( FILE *in, const T_PartialsEntry *entry );
+static bool packPartials ( T_PartialsEntry *entry );
+static uint32_t packInterval ( const T_Interval *interval, uint32_t *out );
+static uint32_t unpackInterval ( const uint32_t *in, uint32_t words, T_Interval *interval );
+static bool reserveWords ( uint32_t words );
+static uint64_t hashFNV ( uint64_t hash, const void *data, size_t size );
+static bool importLog ( const char *FileName, const char *CaptureFile );
+static void *importChunk ( void *arg );
+static int parseLogLine ( const char *s, size_t len, T_ImportRecord *rec );
+static int importWindow ( const char *from, const char *to, T_ImportChunk *chunk, int threads );
+static bool writeReport ( const char *FileName, const char *ReportFile, long range );
+static void *reportChunk ( void *arg );
+static void reportBlock ( T_ReportChunk *c, const uint8_t *block, size_t pos, bool count );
+static void reportPacket ( T_ReportChunk *c, int i, const uint8_t *b, bool count );
+static void reportComplete ( T_ReportChunk *c, int address, T_Transaction *t, const struct timeval *end, bool failed, bool count );
+static void reportSlo ( T_Report *r, int address, const T_Transaction *t, const struct timeval *end, bool failed );
+static void reportSlow ( T_Report *r, const T_ReportSlow *slow );
+static bool isSlower ( const T_ReportSlow *a, const T_ReportSlow *b );
+static void reportMerge ( T_Report *to, const T_Report *from );
+static bool reportTimes ( const uint8_t *block, size_t pos, int64_t *first, int64_t *last );
+static void reportHtml ( FILE *out, const char *FileName, const T_Report *r, int64_t start, int64_t end,
+                         long packets, int threads );
+static void reportHeatmap ( FILE *out, int id, const char *title, const T_Histogram *heat, int64_t start, int64_t end );
+static void reportText ( FILE *out, const char *text );
+static const char *reportDate ( int64_t usec );
+static bool openScript ( const char *FileName );
+static void closeScript ( void );
+static void forwardPacket ( T_VISCAInterface *from, T_VISCAInterface *to, uint8_t rc );
+static void injectInquiries ( const struct timeval *now );
+static bool isInjectedReply ( const T_Camera *cam, const T_VISCAInterface *interface );
+static bool isInjectedVersion ( const T_VISCAInterface *interface, uint8_t rc );
+static bool decodeVersion ( T_VISCAInterface *interface, bool own );
+static bool openShadow ( const char *PortName );
+static void closeShadow ( void );
+static void teeShadow ( uint8_t rc );
+static void *shadowReader ( void *arg );
+static void trackShadow ( const T_VISCAInterface *interface );
+static void completeShadow ( int address, T_Transaction *t, const struct timeval *end, bool failed );
+static void dumpShadow ( void );
+static T_CacheEntry *findCacheEntry ( int address, int cmd, bool create );
+static bool serveInquiry ( uint8_t rc );
+static void cacheReply ( uint8_t rc );
+static bool prefetchReply ( uint8_t rc );
+static void prefetchInquiries ( void );
+static bool holdPacket ( uint8_t rc );
+static void releasePackets ( const struct timeval *now );
+static bool isAdmitted ( int address, int cmd, const struct timeval *now );
+static void paceFeedback ( int address, const T_Transaction *t, const struct timeval *end, const char *congestion );
+static void dumpPace ( void );
+static bool parseSlo ( const char *spec );
+static bool matchSlo ( const T_Slo *slo, int address, const T_Transaction *t );
+static bool isStop ( const T_Transaction *t );
+static bool openHints ( const char *FileName );
+static void closeHints ( void );
+static void addHint ( T_HintWindow *w, long value );
+static void publishHint ( int address, const struct timeval *now );
+static void writeHint ( T_HintCamera *h, const T_HintCamera *v );
+static int readHint ( const T_HintTable *table, int address, T_HintCamera *v );
+static int hintClass ( const T_Transaction *t );
+static void countSlo ( int address, const T_Transaction *t, const struct timeval *end, bool failed );
+static bool isGoodSlo ( const T_Slo *slo, const T_Transaction *t, const struct timeval *end, bool failed );
+static void pushSlo ( const T_Interval *interval );
+static double burnSlo ( uint64_t good, uint64_t total, double objective );
+static void dumpSlo ( void );
+static void querySlo ( int64_t now, long range );
+static void sumStore ( uint32_t id, int64_t from, int64_t to, uint64_t *good, uint64_t *total );
+static T_ScriptEvent *queueScriptEvent ( int type );
+static void postScriptEvent ( void );
+static void trackTransaction ( T_VISCAInterface *interface );
+static int trackReply ( T_Track *track, int type, int sock, const struct timeval *received, T_Transaction **t );
+static void completeTransaction ( int address, T_Transaction *t, const struct timeval *end, bool failed );
+static void dropTransaction ( int address, T_Transaction *t, const struct timeval *now );
+static void trackInitStage ( int address, const T_Transaction *t, const struct timeval *end, bool failed );
+static void resetChain ( const struct timeval *start );
+static void finishInitStage ( int address, int stage, const struct timeval *start, const struct timeval *end, bool failed );
+static void joinGroup ( int address, T_Transaction *t, const T_VISCAInterface *interface );
+static void leaveGroup ( T_Transaction *t, const struct timeval *end, bool failed );
+static void finishGroup ( T_Group *g );
+static void expireGroups ( const struct timeval *now, bool end );
+static void dumpStatistics ( long sender_errors, long receiver_errors );
+static void histAdd ( T_Histogram *h, long value );
+static int histBucket ( long value );
+static long histPercentile ( const T_Histogram *h, double percent );
+static long histLowerBound ( int idx );
+static void histMerge ( T_Histogram *to, const T_Histogram *from );
+static void countPacket ( T_VISCAInterface *interface, uint8_t rc );
+static void countReader ( T_VISCAInterface *interface, int queued, long lag, const struct timeval *now );
+static long queuedPercentile ( const T_IntervalLine *l, int pct );
+static long lagPercentile ( const T_IntervalLine *l, int pct );
+static void checkInterval ( const struct timeval *now );
+static void finishInterval ( uint32_t duration );
+static void closeInterval ( const struct timeval *end );
+static void mergeInterval ( T_Interval *to, const T_Interval *from );
+static bool openStore ( const char *FileName, bool create );
+static void writeStore ( const T_Interval *interval );
+static void closeStore ( void );
+static void retractStore ( int64_t start, uint32_t duration );
+static void queryStore ( long range );
+static bool isInquiry ( int cmd );
+static long int timeDiff ( const struct timeval *from, const struct timeval *to );
+static void getTime ( struct timeval *tick );
+static int64_t scaleTsc ( uint64_t ticks, uint64_t mult );
+static bool initTsc ( void );
+static void calibrateTsc ( const struct timeval *now );
+static bool readTscPair ( uint64_t *tsc, int64_t *mono, int64_t *real );
+static uint64_t readTsc ( void );
+static long int timeDiffUs ( const struct timeval *from, const struct timeval *to );
+static void addTimeline ( const T_VISCAInterface *interface );
+static void blameTransaction ( int address, const T_Transaction *t, const struct timeval *end );
+static void dumpBlame ( const char *name, const T_Blame *b );
 static int findCommand ( const uint8_t *sequence, uint8_t len );
+static void prepareSequences ( void );
+static int decodeAddress ( uint8_t header );
+static uint32_t decodeParameter ( const uint8_t *frame, uint8_t len, int cmd );
+static void findCommands ( const uint8_t *data, size_t size, const uint32_t *offset, const uint8_t *length, int n,
+                           int16_t *cmd, uint8_t *address, uint8_t *socket, uint32_t *param );
+static void runBenchmarks ( void );
+static void benchCapture ( bool direct );
+static size_t benchPackets ( uint8_t *data, uint32_t *offset, uint8_t *length, int n );
+static void benchFramer ( void );
+static void benchFaults ( T_BenchStream *b, const uint8_t *data, const uint32_t *offset, const uint8_t *length,
+                          const double *rate );
+static uint8_t benchOriginal ( T_VISCAInterface *interface, const int16_t *stream, size_t n, size_t *i );
+static double benchFrameBytes ( const int16_t *stream, size_t n, bool resync );
+static void benchReactor ( bool legacy );
+static void benchClock ( void );
+static void benchRender ( void );
+static void benchHints ( void );
+static void *benchHintWriter ( void *arg );
+static void benchFormat ( FILE *out, const T_VISCAInterface *interface, long int diff );
+static long int benchLine ( T_VISCAInterface *interface, const uint8_t *data, const uint32_t *offset,
+                            const uint8_t *length, int i );
+static void *benchWriter ( void *arg );
+static void benchHandle ( T_VISCAInterface *interface, uint8_t rc );
+static bool parseFaults ( const char *spec );
+static bool parseScriptBudget ( const char *spec );
+static double benchTime ( const struct timespec *from );
 static bool setupInterface( T_VISCAInterface *intf, const char *PortName, const char *IntfName );
 static const char *logTime ( const struct timeval *tick, bool full );
 static const char *milliSeconds ( const struct timeval *tick );
@@ -298,37 +1559,152 @@ static void mySignalHandler (int reason);
 
 int main( int argc, char *argv[] )
 {
+    struct timeval now;
     int rc;
 
     fprintf(stderr,"visca-dump %s -- dump VISCA communication using two ports\ncompiled: "__DATE__"\n\n",VERSION);
     if ( !parseArguments(argc,argv) )
         return 2;
 
-    if ( *SenderPortName == '\0' )
+    if ( Benchmark )
     {
-        fputs("ERROR: you have to specify a portname for a sender using parm `-s'!\n", stderr);
-        return 1;
+        runBenchmarks();
+        return 0;
     }
-    if ( *ReceiverPortName == '\0' )
+
+    if ( *ReportFileName != '\0' )
     {
-        fputs("ERROR: you have to specify a portname for a receiver using parm `-r'!\n", stderr);
-        return 1;
+        if ( *ReplayFileName == '\0' )
+        {
+            fputs("ERROR: a report needs the capture file specified with parm `-i'!\n", stderr);
+            return 1;
+        }
+        return writeReport(ReplayFileName,ReportFileName,RrdQuery) ? 0 : 1;
     }
-    installSignalhandler();
-    sender.uart = receiver.uart = NULL;
 
-    if ( !setupInterface(&sender,SenderPortName,"CTL") )
+    if ( RrdQuery > 0 )
     {
-        fprintf(stderr,"ERROR: can't open sender port `%s'!\n",SenderPortName);
-        return 1;
-    }
+        if ( *RrdFileName == '\0' )
+        {
+            fputs("ERROR: a query needs the store specified with parm `-R'!\n", stderr);
+            return 1;
+        }
+        if ( !openStore(RrdFileName,false) )
+            return 1;
+        queryStore(RrdQuery);
+        closeStore();
+        return 0;
+    }
+
+    if ( *ImportFileName != '\0' )
+    {
+        if ( *CaptureFileName == '\0' )
+        {
+            fputs("ERROR: an import needs the capture file specified with parm `-w'!\n", stderr);
+            return 1;
+        }
+        return importLog(ImportFileName,CaptureFileName) ? 0 : 1;
+    }
+
+    if ( *ReplayFileName != '\0' )
+    {
+        if ( *RrdFileName != '\0' && !openStore(RrdFileName,true) )
+            return 1;
+        if ( ReplayCache && (*RrdFileName == '\0' || *ScriptFileName != '\0') )
+        {
+            fputs("ERROR: the cached replay `-K' needs the store `-R' and no script!\n", stderr);
+            return 1;
+        }
+        if ( *ScriptFileName != '\0' && !openScript(ScriptFileName) )
+            return 1;
+        resetChain(NULL);
+        strcpy(sender.name,"CTL");
+        strcpy(receiver.name,"CAM");
+        strcpy(injected.name,"PRX");
+        if ( ReplayCache )
+            rc = replayCached(ReplayFileName) ? 0 : 1;
+        else
+        {
+            rc = replayCapture(ReplayFileName) ? 0 : 1;
+            expireGroups(timercmp(&sender.received,&receiver.received,>) ? &sender.received : &receiver.received,true);
+            closeInterval(timercmp(&sender.received,&receiver.received,>) ? &sender.received : &receiver.received);
+            closeScript();
+            dumpStatistics(SenderErrors,ReceiverErrors);
+        }
+        closeStore();
+        return rc;
+    }
+
+    if ( *SenderPortName == '\0' )
+    {
+        fputs("ERROR: you have to specify a portname for a sender using parm `-s'!\n", stderr);
+        return 1;
+    }
+    if ( *ReceiverPortName == '\0' )
+    {
+        fputs("ERROR: you have to specify a portname for a receiver using parm `-r'!\n", stderr);
+        return 1;
+    }
+    if ( AskVersion && !Proxy )
+    {
+        fputs("warning: -V needs the proxy mode `-P', no VersionInq is sent\n", stderr);
+        AskVersion = false;
+    }
+    if ( CacheTTL > 0 && !Proxy )
+    {
+        fputs("warning: -C needs the proxy mode `-P', no inquiry is cached\n", stderr);
+        CacheTTL = 0;
+    }
+    if ( PrefetchCap > 0 && CacheTTL <= 0 )
+    {
+        fputs("warning: -F needs the cache `-C', no inquiry is prefetched\n", stderr);
+        PrefetchCap = 0;
+    }
+    if ( PaceCeiling > 0 && !Proxy )
+    {
+        fputs("warning: -L needs the proxy mode `-P', the commands aren't paced\n", stderr);
+        PaceCeiling = 0;
+    }
+    if ( *ShadowPortName != '\0' && !Proxy )
+    {
+        fputs("warning: -S needs the proxy mode `-P', the shadow port isn't used\n", stderr);
+        *ShadowPortName = '\0';
+    }
+    if ( *RrdFileName != '\0' && !openStore(RrdFileName,true) )
+        return 1;
+    if ( *CaptureFileName != '\0' )
+    {
+        Capture = openCapture(CaptureFileName,CaptureDirect);
+        if ( !Capture )
+            return 1;
+    }
+    if ( *ScriptFileName != '\0' && !openScript(ScriptFileName) )
+        return 1;
+    if ( *HintFileName != '\0' && !openHints(HintFileName) )
+        return 1;
+    installSignalhandler();
+    sender.uart = receiver.uart = shadow.uart = NULL;
+    resetChain(NULL);
+    strcpy(injected.name,"PRX");
+
+    if ( !setupInterface(&sender,SenderPortName,"CTL") )
+    {
+        fprintf(stderr,"ERROR: can't open sender port `%s'!\n",SenderPortName);
+        return 1;
+    }
     if ( !setupInterface(&receiver,ReceiverPortName,"CAM") )
     {
         fprintf(stderr,"ERROR: can't open receiver port `%s'!\n",ReceiverPortName);
         return 1;
     }
+    if ( *ShadowPortName != '\0' && !openShadow(ShadowPortName) )
+    {
+        fprintf(stderr,"ERROR: can't open shadow port `%s'!\n",ShadowPortName);
+        return 1;
+    }
 
 
+    initTsc();
     printf("==============================================\n");
     dumpPacketStreams();
     printf("==============================================\n");
@@ -352,91 +1728,157 @@ int main( int argc, char *argv[] )
         else
             fputs("INFO: receiver port closed!\n", stderr);
     }
+    closeShadow();
+    closeScript();
+    closeCapture(Capture);
+    getTime(&now);
+    expireGroups(&now,true);
+    closeInterval(&now);
+    closeStore();
+    closeHints();
     return 0;
 }
 
 
 void dumpPacketStreams ( void )
 {
-    long int diff;
-    bool wait_response=false;
-    bool done=false;
-    uint8_t rc;
-    long int sender_errors = 0;
-    long int receiver_errors = 0;
-    int dumps = 0;
+    T_VISCAInterface *ports[MAX_LINES] = { &sender, &receiver };
+    struct timeval now;
 
     do
     {
-        // if we have data from the sender/controller, dump it
-        if ( v24HaveData(sender.uart) )
+        getTime(&now);
+        checkInterval(&now);
+        calibrateTsc(&now);
+
+        // wait for the data of the sender/controller and the receiver/camera
+        pollPorts(ports,MAX_LINES,handlePacket,REACTOR_TICK);
+        getTime(&now);
+        if ( PaceCeiling > 0 )
+            releasePackets(&now);
+        if ( AskVersion )
+            injectInquiries(&now);
+        if ( PrefetchCap > 0 )
+            prefetchInquiries();
+    }
+    while ( !Terminate );
+}
+
+/* Forward, capture and dump a packet received from a port, see pollPorts().
+ */
+static void handlePacket ( T_VISCAInterface *interface, uint8_t rc )
+{
+    getTime(&LastTraffic);
+    if ( interface == &sender )
+    {
+        if ( serveInquiry(rc) || !holdPacket(rc) )
         {
-            rc = getViscaPacket(&sender);
-            if ( rc==VISCA_SUCCESS )
-            {
-                wait_response = true;
-                dumpViscaPacket(&sender,0L);
-            }
+            if ( !sender.cached )
+                forwardPacket(&sender,&receiver,rc);
+            teeShadow(rc);
+            writeCapture(Capture,LINE_CTL,rc,&sender.received,sender.buffer,sender.num,
+                         sender.cached ? CAPTURE_PROXY : 0);
+            processPacket(&sender,rc);
+        }
+    }
+    else if ( isInjectedVersion(&receiver,rc) )
+    {
+        // the reply to the VersionInq of the proxy, no transaction of the controller
+        writeCapture(Capture,LINE_CAM,rc,&receiver.received,receiver.buffer,receiver.num,CAPTURE_INJECTED|CAPTURE_OWN);
+        countPacket(&receiver,rc);
+        decodeVersion(&receiver,true);
+    }
+    else if ( prefetchReply(rc) )
+    {
+        // the reply to a prefetch of the proxy, no transaction of the controller
+        writeCapture(Capture,LINE_CAM,rc,&receiver.received,receiver.buffer,receiver.num,CAPTURE_INJECTED|CAPTURE_OWN);
+        countPacket(&receiver,rc);
+    }
+    else
+    {
+        forwardPacket(&receiver,&sender,rc);
+        cacheReply(rc);
+        writeCapture(Capture,LINE_CAM,rc,&receiver.received,receiver.buffer,receiver.num,0);
+        processPacket(&receiver,rc);
+    }
+}
+
+/* Process a packet received by `interface`. The packet is dumped and added
+ * to the statistics. `rc` is the return code of getViscaPacket(). This is
+ * used for the live data and the replay of a capture file.
+ */
+void processPacket ( T_VISCAInterface *interface, uint8_t rc )
+{
+    T_ScriptEvent *ev;
+    long int diff;
+
+    countPacket(interface,rc);
+    if ( interface==&receiver )
+        addTimeline(interface);
+    if ( (ev = queueScriptEvent(SCRIPT_Packet)) != NULL )
+    {
+        ev->line = (interface==&sender) ? LINE_CTL : LINE_CAM;
+        ev->num = (uint8_t)interface->num;
+        ev->status = rc;
+        ev->cmd = (rc==VISCA_SUCCESS) ? (int16_t)interface->cmd : -1;
+        ev->address = (rc==VISCA_SUCCESS) ? (int8_t)interface->address : -1;
+        ev->tick = interface->received;
+        memcpy(ev->data,interface->buffer,interface->num);
+        postScriptEvent();
+    }
+    if ( rc!=VISCA_SUCCESS )
+    {
+        if ( interface->cnt > 0)                // count errors only after a
+        {                                       // communication is established
+            if ( interface==&sender )
+                SenderErrors++;
             else
-            {
-                if ( sender.cnt > 0)                    // count errors only after a
-                    sender_errors++;                    // communication is established
-                if ( rc!=VISCA_BAD_HEADER )
-                {
-                    dumpBadPacket(&sender);
-                }
-            }
+                ReceiverErrors++;
         }
-        // if we have data from the receiver/camera, dump it
-        if ( v24HaveData(receiver.uart) )
+        if ( rc!=VISCA_BAD_HEADER )
         {
-            rc = getViscaPacket(&receiver);
-            if ( rc==VISCA_SUCCESS )
-            {
-                if ( wait_response )
-                {
-                    if ( receiver.type==VISCA_TYPE_RESPONSE_ACK )
-                    {
-                        diff=addToAvarage(&sender.received,&receiver.received,&avg_ack);
-                    }
-                    else
-                    {
-                        diff=addToAvarage(&sender.received,&receiver.received,&avg_done);
-                        wait_response = false;
-                    }
-                }
-                else
-                    diff = 0L;
-                dumpViscaPacket(&receiver,diff);
-                dumps++;
-                if ( dumps >=100 )
-                {
-                    dumps = 0;
-                    printf("~~~~~~~~~~~~~~~~~~~ ack=%Lf (%ld) | done=%Lf (%ld) [ms] | unknown=%ld/%ld | errors=%ld/%ld\n",
-                           avg_ack.current,avg_ack.cnt,
-                           avg_done.current,avg_done.cnt,
-                           sender.unknown,receiver.unknown,
-                           sender_errors,receiver_errors);
-                }
-            }
-            else
-            {
-                if ( receiver.cnt > 0)                  // count errors only after a
-                    receiver_errors++;                  // communication is established
-                if ( rc!=VISCA_BAD_HEADER )
-                {
-                    dumpBadPacket(&receiver);
-                }
-            }
+            dumpBadPacket(interface);
+        }
+        return;
+    }
+    if ( interface==&sender )
+    {
+        WaitResponse = !sender.cached;
+        dumpViscaPacket(&sender,0L);
+        if ( sender.cached )
+            dumpViscaPacket(&injected,0L);
+        trackTransaction(&sender);
+        return;
+    }
+    if ( WaitResponse )
+    {
+        if ( receiver.type==VISCA_TYPE_RESPONSE_ACK )
+        {
+            diff=addToAvarage(&sender.received,&receiver.received,&avg_ack);
+        }
+        else
+        {
+            diff=addToAvarage(&sender.received,&receiver.received,&avg_done);
+            WaitResponse = false;
         }
     }
-    while ( !done );
+    else
+        diff = 0L;
+    dumpViscaPacket(&receiver,diff);
+    trackTransaction(&receiver);
+    Dumps++;
+    if ( Dumps >=100 )
+    {
+        Dumps = 0;
+        dumpStatistics(SenderErrors,ReceiverErrors);
+    }
 }
 
-/* Dump a VISCA packet and it's statistic information. The 'received' timestamp
- * is used as time reference using "logTime(false)". The packet data is dumped
- * as raw data in HEX. The data is used to find the command and to determine
- * it's name. The parameters aren't explained.
+/* Dump a VISCA packet and it's statistic information. The line is rendered by
+ * the plan of the column template (-T, see compileTemplate). The default
+ * template "%t %n: %h{%d}  - %c" gives the classic layout: the 'received'
+ * timestamp, the packet as raw data in HEX, the reply times and the name of
+ * the command. The parameters aren't explained.
  *
  * Each packet is logged in an single line:
  *
@@ -455,41 +1897,284 @@ void dumpPacketStreams ( void )
  */
 void dumpViscaPacket ( T_VISCAInterface *interface, long int diff )
 {
-    long double avg;
-    char type;
-    int cmd;
-    int i;
+    char line[RENDER_LINE];
+    size_t len;
 
     if ( !interface->valid )
         return;
-    printf("%s %3.3s: ",logTime(&(interface->received),false),interface->name);
-    for ( i=0; i<VISCA_MAX_SIZE; i++ )
+    if ( interface->cmd==0 )
+        interface->unknown++;
+    if ( Quiet )
+        return;
+    len = renderPacket(&Render,line,interface,diff);
+    fwrite(line,1,len,stdout);
+}
+
+/* Compile the column template `spec` into `plan`. A column is a `%', an
+ * optional width (the column is padded with blanks) and a letter of
+ * RenderLetters, `%%' is a single `%'. The other characters are copied. The
+ * line may not exceed RENDER_LINE bytes.
+ */
+static bool compileTemplate ( T_RenderPlan *plan, const char *spec )
+{
+    static const size_t widths[RENDER_MAX_TYPES] =      // maximum by RENDER_xxx
     {
-        if ( i < interface->num )
-            printf("%2.2X ",interface->buffer[i]);
-        else
-            printf("   ");
+        0, 14, 27, 3, 3*VISCA_MAX_SIZE, 3*VISCA_MAX_SIZE-1, 2, 1, 2, 8, 39, 0
+    };
+    T_RenderOp *op;
+    const char *letter;
+    size_t text = 0, line = 1, name = 0, max;
+    int i, width;
+
+    for ( i=0; i<=CMD_MAX_SEQUENCES; i++ )
+        if ( SequenceNames[i] && strlen(SequenceNames[i]) > name )
+            name = strlen(SequenceNames[i]);
+
+    memset(plan,0,sizeof(*plan));
+    plan->second = -1;
+    while ( *spec )
+    {
+        if ( *spec != '%' || spec[1] == '%' )
+        {
+            // literals in a row make a single op
+            if ( text >= sizeof(plan->text) )
+                return false;
+            if ( plan->cnt == 0 || plan->op[plan->cnt-1].op != RENDER_Literal )
+            {
+                if ( plan->cnt >= RENDER_MAX_OPS )
+                    return false;
+                op = &plan->op[plan->cnt++];
+                op->op = RENDER_Literal;
+                op->from = (uint16_t)text;
+            }
+            else
+                op = &plan->op[plan->cnt-1];
+            plan->text[text++] = *spec;
+            op->len++;
+            line++;
+            spec += (*spec == '%') ? 2 : 1;
+            continue;
+        }
+
+        width = 0;
+        for ( spec++; isdigit((unsigned char)*spec); spec++ )
+        {
+            width = width*10 + (*spec-'0');
+            if ( width > RENDER_MAX_WIDTH )
+                return false;
+        }
+        letter = (*spec != '\0') ? strchr(RenderLetters+1,*spec) : NULL;
+        if ( !letter || plan->cnt >= RENDER_MAX_OPS )
+            return false;
+        op = &plan->op[plan->cnt++];
+        op->op = (uint8_t)(letter-RenderLetters);
+        op->width = (uint8_t)width;
+        max = (op->op == RENDER_Command) ? name : widths[op->op];
+        line += ((size_t)width > max) ? (size_t)width : max;
+        spec++;
     }
-    if ( interface->type==VISCA_TYPE_RESPONSE_ACK )
+    return line <= RENDER_LINE;
+}
+
+/* Render the line of a packet into `line` (RENDER_LINE bytes) by the plan of
+ * compileTemplate(). Returns the length of the line including the newline.
+ * The line isn't terminated.
+ */
+static size_t renderPacket ( T_RenderPlan *plan, char *line, const T_VISCAInterface *interface, long int diff )
+{
+    const T_RenderOp *op, *end = plan->op + plan->cnt;
+    const uint8_t *b = interface->buffer;
+    const char *name;
+    char *p = line, *col;
+    size_t len;
+    int i, address;
+
+    for ( op=plan->op; op<end; op++ )
     {
-        avg = avg_ack.current;
-        type = 'A';
+        col = p;
+        switch ( op->op )
+        {
+            case RENDER_Literal:
+                memcpy(p,plan->text+op->from,op->len);
+                p += op->len;
+                break;
+            case RENDER_Time:
+                p = renderTime(plan,p,&interface->received);
+                break;
+            case RENDER_Epoch:
+                p = renderNumber(p,(unsigned long)interface->received.tv_sec,1);
+                *p++ = '.';
+                p = renderNumber(p,(unsigned long)interface->received.tv_usec,6);
+                break;
+            case RENDER_Name:
+                len = strnlen(interface->name,3);
+                memset(p,' ',3-len);
+                memcpy(p+3-len,interface->name,len);
+                p += 3;
+                break;
+            case RENDER_Hex:
+            case RENDER_Raw:
+                for ( i=0; i<interface->num; i++ )
+                {
+                    p[0] = RenderHex[b[i] >> 4];
+                    p[1] = RenderHex[b[i] & 0x0F];
+                    p[2] = ' ';
+                    p += 3;
+                }
+                if ( op->op == RENDER_Hex )
+                {
+                    memset(p,' ',3*(VISCA_MAX_SIZE-i));
+                    p += 3*(VISCA_MAX_SIZE-i);
+                }
+                else if ( i > 0 )
+                    p--;
+                break;
+            case RENDER_Length:
+                p = renderNumber(p,(unsigned long)interface->num,1);
+                break;
+            case RENDER_Address:
+                address = decodeAddress(b[0]);
+                *p++ = (address == VISCA_BROADCAST) ? '*' : (char)('0'+address);
+                break;
+            case RENDER_Socket:
+                p = renderNumber(p,((b[0] & 0x70) && (b[1] & 0xF0) >= VISCA_TYPE_RESPONSE_ACK)
+                                   ? (b[1] & 0x0F) : 0,1);
+                break;
+            case RENDER_Param:
+                if ( interface->cmd > 0 )
+                    p = renderNumber(p,decodeParameter(b,(uint8_t)interface->num,interface->cmd),-4);
+                else
+                    *p++ = '-';
+                break;
+            case RENDER_Reply:
+                if ( !diff )
+                {
+                    memcpy(p,"    /       ",12);
+                    p += 12;
+                }
+                else if ( interface->type==VISCA_TYPE_RESPONSE_ACK )
+                    p = renderReply(p,diff,avg_ack.current,'A');
+                else
+                    p = renderReply(p,diff,avg_done.current,'D');
+                break;
+            case RENDER_Command:
+                name = SequenceNames[interface->cmd];
+                len = strlen(name);
+                memcpy(p,name,len);
+                p += len;
+                break;
+        }
+        if ( p-col < op->width )
+        {
+            memset(p,' ',op->width-(p-col));
+            p = col+op->width;
+        }
     }
-    else
+    *p++ = '\n';
+    return (size_t)(p-line);
+}
+
+/* Write "HH:MM:SS[mmmm]" like logTime(). localtime() is called once per
+ * second only.
+ */
+static char *renderTime ( T_RenderPlan *plan, char *p, const struct timeval *tick )
+{
+    struct tm *t;
+
+    if ( tick->tv_sec != plan->second )
     {
-        avg = avg_done.current;
-        type = 'D';
+        plan->second = tick->tv_sec;
+        t = localtime(&(tick->tv_sec));
+        plan->local = (t != NULL);
+        if ( t )
+        {
+            plan->clock[0] = (char)('0'+t->tm_hour/10);
+            plan->clock[1] = (char)('0'+t->tm_hour%10);
+            plan->clock[2] = ':';
+            plan->clock[3] = (char)('0'+t->tm_min/10);
+            plan->clock[4] = (char)('0'+t->tm_min%10);
+            plan->clock[5] = ':';
+            plan->clock[6] = (char)('0'+t->tm_sec/10);
+            plan->clock[7] = (char)('0'+t->tm_sec%10);
+        }
     }
+    if ( !plan->local )
+    {
+        memcpy(p,"NULL",4);
+        return p+4;
+    }
+    memcpy(p,plan->clock,8);
+    p[8] = '[';
+    renderNumber(p+9,(unsigned long)(tick->tv_usec/1000),4);
+    p[13] = ']';
+    return p+14;
+}
 
-    if ( diff )
-        printf("{%4.4ld/%6.2Lf%c} ",diff,avg,type);
+/* Write "dddd/aaa.aaT" like "%4.4ld/%6.2Lf%c". printf() rounds the exact
+ * binary value, so an avarage close to a tie of the last digit, a large or a
+ * negative one is written by snprintf().
+ */
+static char *renderReply ( char *p, long int diff, long double avg, char type )
+{
+    unsigned long cents;
+    long double x;
+    char tmp[8];
+    int n;
+
+    if ( diff < 0 )
+    {
+        *p++ = '-';
+        p = renderNumber(p,(unsigned long)-diff,4);
+    }
+    else
+        p = renderNumber(p,(unsigned long)diff,4);
+    *p++ = '/';
+    x = avg*100.0L;
+    if ( avg >= 0.0L && avg < 9999.99L && fabsl(x-floorl(x)-0.5L) > 1e-6L )
+    {
+        cents = (unsigned long)(x+0.5L);
+        n = (int)(renderNumber(tmp,cents/100,1)-tmp);
+        if ( n < 3 )
+        {
+            memset(p,' ',3-n);
+            p += 3-n;
+        }
+        memcpy(p,tmp,n);
+        p += n;
+        *p++ = '.';
+        p = renderNumber(p,cents%100,2);
+    }
     else
-        printf("{    /       } ");
+    {
+        n = snprintf(p,24,"%6.2Lf",avg);
+        p += (n > 23) ? 23 : n;
+    }
+    *p++ = type;
+    return p;
+}
 
-    cmd = findCommand(interface->buffer,interface->num);
-    printf(" - %s\n",SequenceNames[cmd]);
-    if ( cmd==0 )
-        interface->unknown++;
+/* Write `value` in decimal with at least `digits` digits. A negative `digits`
+ * writes hex.
+ */
+static char *renderNumber ( char *p, unsigned long value, int digits )
+{
+    char tmp[24];
+    unsigned base = 10;
+    int n = 0;
+
+    if ( digits < 0 )
+    {
+        base = 16;
+        digits = -digits;
+    }
+    do
+    {
+        tmp[n++] = RenderHex[value % base];
+        value /= base;
+    } while ( value || n < digits );
+    while ( n > 0 )
+        *p++ = tmp[--n];
+    return p;
 }
 
 /* Simply a raw dump of the chunk of received data.
@@ -498,6 +2183,8 @@ void dumpBadPacket ( T_VISCAInterface *interface )
 {
     int i;
 
+    if ( Quiet )
+        return;
     printf("%s %3.3s: ",logTime(&(interface->received),false),interface->name);
     for ( i=0; i<VISCA_MAX_SIZE; i++ )
     {
@@ -548,54 +2235,226 @@ void dumpErrorMessage ( int rc )
  */
 static uint8_t getViscaPacket ( T_VISCAInterface *interface )
 {
-    int cnt_read;
-    int pos;
+    uint8_t byte;
+    uint8_t rc;
 
     interface->timedout = false;
     interface->valid = false;
+    interface->cached = false;
+    interface->num = 0;
 
-    /* read first byte, the header
-     */
-    pos = 0;
-    cnt_read = v24Read(interface->uart,interface->buffer,sizeof(uint8_t));
-    if ( cnt_read <= 0 )
+    do
     {
-        fprintf(stderr,"ERROR(%s): timeout! No data.\n",interface->name);
-        interface->timedout = true;
-        return VISCA_TIMEDOUT;
+        if ( v24Read(interface->uart,&byte,sizeof(uint8_t)) <= 0 )
+            rc = frameByte(interface,-1);
+        else
+        {
+            if ( interface->pos == 0 )
+                getTime(&interface->start);
+            rc = frameByte(interface,byte);
+        }
     }
-    if ( !(interface->buffer[pos] & 0x80) )
+    while ( rc == VISCA_PENDING );
+
+    rc = finishPacket(interface,rc);
+    if ( rc == VISCA_TRUNCATED )
+        getTime(&interface->start);             // the new header
+    return rc;
+}
+
+/* Finish a packet returned by frameByte(): decode it or report the error.
+ */
+static uint8_t finishPacket ( T_VISCAInterface *interface, uint8_t rc )
+{
+    interface->valid = false;
+    interface->cached = false;
+    interface->timedout = (rc == VISCA_TIMEDOUT);
+    switch ( rc )
     {
-        fprintf(stderr,"ERROR(%s): bad header!\n",interface->name);
-        return VISCA_BAD_HEADER;
+        case VISCA_SUCCESS:
+            return decodePacket(interface);
+        case VISCA_TIMEDOUT:
+            if ( interface->num == 0 )
+                fprintf(stderr,"ERROR(%s): timeout! No data.\n",interface->name);
+            else
+                fprintf(stderr,"ERROR(%s): timeout! Abort.\n",interface->name);
+            break;
+        case VISCA_BAD_HEADER:
+            fprintf(stderr,"ERROR(%s): bad header!\n",interface->name);
+            break;
+        case VISCA_OVERFLOW:
+            fprintf(stderr,"ERROR(%s): overflow! Abort.\n",interface->name);
+            break;
+        case VISCA_TRUNCATED:
+            fprintf(stderr,"ERROR(%s): truncated! Resync.\n",interface->name);
+            break;
+        default:
+            break;
     }
-    gettimeofday(&(interface->received),NULL);
+    return rc;
+}
 
-    while ( interface->buffer[pos] != VISCA_TERMINATOR )
+/* Wait up to `timeout` [ms] for data of the ports, read all available bytes
+ * of each port at once and pass each packet to `handle`. So a port never
+ * waits for the rest of a packet of the other one. The bytes of a read came
+ * in one after the other, the last one just now (but not before the last
+ * read), so the first byte of a packet is dated back by its position. With a
+ * timeout `-t`, a packet without a byte for that time is aborted.
+ *
+ * The CPU time spent on each port (read, framing and `handle`) is added to
+ * its `busy` time. Before each read, the bytes queued in the kernel and the
+ * lag of the read after the wake-up are counted by countReader().
+ */
+static void pollPorts ( T_VISCAInterface **ports, int n, void (*handle)( T_VISCAInterface *, uint8_t ), int timeout )
+{
+    struct pollfd pfd[MAX_LINES];
+    struct timespec c0, c1;
+    struct timeval now, tick;
+    uint8_t data[REACTOR_READ];
+    T_VISCAInterface *p;
+    long age;
+    int i, j, got, queued;
+    uint8_t rc;
+
+    for ( i=0; i<n; i++ )
     {
-        pos++;
-        if ( pos >= VISCA_MAX_SIZE )
+        pfd[i].fd = v24QueryFileHandle(ports[i]->uart);
+        pfd[i].events = POLLIN;
+        pfd[i].revents = 0;
+    }
+    if ( poll(pfd,n,timeout) < 0 )
+        return;                         // e.g. interrupted by a signal
+    getTime(&now);
+    for ( i=0; i<n; i++ )
+    {
+        p = ports[i];
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID,&c0);
+        if ( pfd[i].revents & POLLIN )
         {
-            fprintf(stderr,"ERROR(%s): overflow! Abort.\n",interface->name);
-            interface->num = pos;
-            return VISCA_OVERFLOW;
+            /* The data was readable at the wake-up, the lag is the time
+             * spent since then, e.g. on the other port. How long the bytes
+             * were queued before isn't known: an USB adapter hands over a
+             * packet at once, so the queue is counted in bytes only.
+             */
+            if ( ioctl(pfd[i].fd,FIONREAD,&queued) < 0 )
+                queued = 0;
+            getTime(&tick);
+            countReader(p,queued,timeDiffUs(&now,&tick),&tick);
+            got = (int)read(pfd[i].fd,data,sizeof(data));
+            for ( j=0; j<got; j++ )
+            {
+                age = (long)(got-1-j) * VISCA_BYTE_TIME;
+                tick.tv_sec = now.tv_sec - age/1000000L;
+                tick.tv_usec = now.tv_usec - age%1000000L;
+                if ( tick.tv_usec < 0 )
+                {
+                    tick.tv_sec--;
+                    tick.tv_usec += 1000000L;
+                }
+                if ( timercmp(&tick,&p->polled,<) )
+                    tick = p->polled;
+                if ( p->pos == 0 )
+                    p->start = tick;
+                rc = frameByte(p,data[j]);
+                if ( rc == VISCA_PENDING )
+                    continue;
+                rc = finishPacket(p,rc);
+                if ( rc == VISCA_TRUNCATED )
+                    p->start = tick;    // the new header
+                handle(p,rc);
+            }
+            if ( got > 0 )
+                p->polled = now;
         }
-        cnt_read = v24Read(interface->uart,&interface->buffer[pos],sizeof(uint8_t));
-        if ( cnt_read <= 0 )
+        else if ( pfd[i].revents & (POLLERR|POLLHUP|POLLNVAL) )
         {
-            fprintf(stderr,"ERROR(%s): timeout! Abort.\n",interface->name);
-            interface->num = pos + 1;
-            interface->timedout = true;
-            return VISCA_TIMEDOUT;  //  wie hier mittendrin reagieren? Mit Timeout Error raus
+            fprintf(stderr,"ERROR(%s): port lost!\n",p->name);
+            Terminate = 1;
         }
+        else if ( p->pos > 0 && MyTimeOut > 0 && timeDiff(&p->polled,&now) >= MyTimeOut*1000L )
+        {
+            rc = finishPacket(p,frameByte(p,-1));
+            handle(p,rc);
+        }
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID,&c1);
+        p->busy += (c1.tv_sec-c0.tv_sec)*1000000L + (c1.tv_nsec-c0.tv_nsec)/1000L;
     }
-    interface->num = pos + 1;
+}
+
+/* Add a byte to the packet being received, `byte` is -1 for a timeout. The
+ * function returns VISCA_PENDING until a packet (or a bad chunk of data) is
+ * complete and copied to `interface->buffer`. The caller sets `start` for the
+ * first byte of a packet.
+ *
+ * A header byte within a packet starts a new packet, and the bytes before are
+ * VISCA_TRUNCATED. Only valid headers start a packet, e.g. a lone terminator
+ * is a bad header.
+ */
+static uint8_t frameByte ( T_VISCAInterface *interface, int byte )
+{
+    uint8_t rc;
+
+    if ( byte < 0 )
+    {
+        interface->timedout = true;
+        if ( interface->pos == 0 )
+        {
+            interface->num = 0;
+            return VISCA_TIMEDOUT;
+        }
+        rc = VISCA_TIMEDOUT;
+    }
+    else if ( interface->pos == 0 )
+    {
+        if ( VISCA_IS_HEADER(byte) )
+        {
+            interface->frame[interface->pos++] = (uint8_t)byte;
+            return VISCA_PENDING;
+        }
+        interface->frame[interface->pos++] = (uint8_t)byte;
+        rc = VISCA_BAD_HEADER;
+    }
+    else if ( VISCA_IS_HEADER(byte) )
+    {
+        memcpy(interface->buffer,interface->frame,interface->pos);
+        interface->num = interface->pos;
+        interface->received = interface->start;
+        interface->frame[0] = (uint8_t)byte;
+        interface->pos = 1;
+        return VISCA_TRUNCATED;
+    }
+    else
+    {
+        interface->frame[interface->pos++] = (uint8_t)byte;
+        if ( byte == VISCA_TERMINATOR )
+            rc = VISCA_SUCCESS;
+        else if ( interface->pos >= VISCA_MAX_SIZE )
+            rc = VISCA_OVERFLOW;
+        else
+            return VISCA_PENDING;
+    }
+    memcpy(interface->buffer,interface->frame,interface->pos);
+    interface->num = interface->pos;
+    interface->received = interface->start;
+    interface->pos = 0;
+    return rc;
+}
+
+/* Decode a complete packet in `interface->buffer` with `interface->num` bytes.
+ * The type, address and sequence id are set.
+ */
+static uint8_t decodePacket ( T_VISCAInterface *interface )
+{
+    interface->valid = false;
     if ( interface->num < VISCA_MIN_SIZE )
     {
         fprintf(stderr,"ERROR(%s): pkt to small!\n",interface->name);
         return VISCA_FAILURE;
     }
     interface->type = interface->buffer[1] & 0xF0;
+    interface->address = decodeAddress(interface->buffer[0]);
+    interface->broadcast = (interface->address == VISCA_BROADCAST);
+    interface->cmd = findCommand(interface->buffer,interface->num);
     interface->valid = true;
     interface->cnt++;
     return VISCA_SUCCESS;
@@ -639,153 +2498,5889 @@ static int findCommand ( const uint8_t *sequence, uint8_t len )
     return 0;
 }
 
-/* Setup the serial interfaces using the ezV24 library.
+/* Track the transactions of each camera. A command of the sender is "pending"
+ * until the camera sends the ACK. Than it's bound to the socket of the ACK,
+ * until the completion (or error) with this socket is received. Inquiries and
+ * some commands are completed without an ACK.
+ *
+ * The initialisation of the chain (AddressSet, IfClear, Power, first inquiry)
+ * is tracked here too.
  */
-static bool setupInterface ( T_VISCAInterface *intf, const char *PortName, const char *IntfName )
+static void trackTransaction ( T_VISCAInterface *interface )
 {
-    int rc;
+    T_Camera *cam;
+    T_Transaction *t;
+    int address, sock, i, j;
 
-    if ( intf==NULL  || PortName==NULL )
+    if ( !interface->valid || interface->cmd < 0 || interface->cached )
+        return;
+    address = interface->address;
+
+    if ( interface == &sender )
     {
-        fputs("ERROR: setupInterface(): invalid parameter!\n", stderr);
-        return false;
+        if ( interface->cmd == CMD_SetAdress )
+        {
+            resetChain(&interface->received);
+            return;
+        }
+        if ( interface->broadcast )
+        {
+            // a broadcast is answered by the broadcast returned by the chain
+            if ( interface->cmd == CMD_IfClear )
+            {
+                for ( i=0; i<=VISCA_MAX_CAMERAS; i++ )
+                {
+                    if ( cameras[i].track.pending.active )
+                        dropTransaction(i,&cameras[i].track.pending,&interface->received);
+                    for ( j=1; j<=VISCA_SOCKETS; j++ )
+                        if ( cameras[i].track.socket[j].active )
+                            dropTransaction(i,&cameras[i].track.socket[j],&interface->received);
+                }
+            }
+            address = 0;
+        }
+        cam = &cameras[address];
+        if ( cam->track.pending.active )
+            dropTransaction(address,&cam->track.pending,&interface->received);     // no reply at all
+        cam->present = (address != 0);
+        cam->track.pending.active = true;
+        cam->track.pending.cmd = interface->cmd;
+        cam->track.pending.sent = interface->received;
+        cam->track.pending.num = interface->num;
+        cam->track.pending.blocked = !isInquiry(interface->cmd)
+                               && cam->track.socket[1].active && cam->track.socket[2].active;
+        timerclear(&cam->track.pending.freed);
+        i = interface->cmd ? sequences[interface->cmd-1].comparable+1 : VISCA_MAX_SIZE;
+        cam->track.pending.param = (i < interface->num-1) ? interface->buffer[i] : 0;
+        joinGroup(address,&cam->track.pending,interface);
+        return;
     }
 
-    /* First we have to open the port.
+    /* the reply of the camera
      */
-    intf->uart = v24OpenPort(PortName,MyOpenFlags);
-    if ( intf->uart == NULL )
+    if ( interface->broadcast )
     {
-        fputs("ERROR: sorry, open failed!\n", stderr);
-        return false;
+        if ( interface->cmd == RPL_Address && ChainStarted )
+        {
+            ChainSize = interface->buffer[2] - 1;
+            if ( ChainSize > VISCA_MAX_CAMERAS )
+                ChainSize = VISCA_MAX_CAMERAS;
+            finishInitStage(0,INIT_Address,&ChainStart,&interface->received,false);
+            for ( i=1; i<=ChainSize; i++ )
+            {
+                cameras[i].present = true;
+                cameras[i].init[INIT_Address] = cameras[0].init[INIT_Address];
+            }
+        }
+        else if ( interface->cmd == cameras[0].track.pending.cmd && cameras[0].track.pending.active )
+        {
+            completeTransaction(0,&cameras[0].track.pending,&interface->received,false);
+        }
+        return;
     }
-    fprintf(stderr,"INFO: port '%s' opened!\n",PortName);
-    intf->timedout = false;
-    intf->valid = false;
-    intf->unknown = 0;
-    intf->cnt = 0;
+    if ( address < 1 || address > VISCA_MAX_CAMERAS )
+        return;
+    cam = &cameras[address];
+    cam->present = true;
+    if ( interface->cmd == RPL_Version )
+        decodeVersion(interface,false);
+    sock = interface->buffer[1] & 0x0F;
+    switch ( trackReply(&cam->track,interface->type,sock,&interface->received,&t) )
+    {
+        case TRACK_Ack:
+            paceFeedback(address,t,&interface->received,NULL);
+            histAdd(&Interval.cam[address].ack,timeDiff(&t->sent,&t->acked));
+            if ( Hints )
+            {
+                addHint(&HintAck[address][hintClass(t)],timeDiff(&t->sent,&t->acked));
+                publishHint(address,&interface->received);
+            }
+            break;
+        case TRACK_Done:
+            if ( t == &cam->track.pending )
+                paceFeedback(address,t,&interface->received,NULL);
+            completeTransaction(address,t,&interface->received,false);
+            break;
+        case TRACK_Failed:
+            if ( interface->buffer[2] == 0x03 )
+                paceFeedback(address,t,&interface->received,"buffer full");
+            completeTransaction(address,t,&interface->received,true);
+            break;
+        default:
+            break;
+    }
+}
 
-    /* than we have to configure the port.
+/* Match a reply of a camera (`type`, socket `sock`) with its transactions:
+ *
+ * - an ACK moves the pending command into the socket
+ * - a completion finishes the socket, else the pending command (e.g. the
+ *   reply of an inquiry)
+ * - an error fails the pending command first (e.g. buffer full), else the
+ *   socket
+ *
+ * `*t` is the transaction acknowledged or finished. A finished transaction
+ * is still active, the caller completes it.
+ */
+static int trackReply ( T_Track *track, int type, int sock, const struct timeval *received, T_Transaction **t )
+{
+    T_Transaction *s = (sock >= 1 && sock <= VISCA_SOCKETS) ? &track->socket[sock] : NULL;
+
+    *t = NULL;
+    switch ( type )
+    {
+        case VISCA_TYPE_RESPONSE_ACK:
+            if ( !track->pending.active || !s )
+                return TRACK_None;
+            *s = track->pending;
+            s->acked = *received;
+            track->pending.active = false;
+            *t = s;
+            return TRACK_Ack;
+        case VISCA_TYPE_RESPONSE_COMPLETED:
+            if ( s && s->active )
+                *t = s;
+            else if ( track->pending.active )
+                *t = &track->pending;
+            return *t ? TRACK_Done : TRACK_None;
+        case VISCA_TYPE_RESPONSE_ERROR:
+            if ( track->pending.active )
+                *t = &track->pending;
+            else if ( s && s->active )
+                *t = s;
+            return *t ? TRACK_Failed : TRACK_None;
+        default:
+            return TRACK_None;
+    }
+}
+
+/* A transaction is finished by a completion or an error. Address 0 is used
+ * for broadcasts.
+ */
+static void completeTransaction ( int address, T_Transaction *t, const struct timeval *end, bool failed )
+{
+    T_Camera *cam = &cameras[address];
+    T_ScriptEvent *ev;
+    int i;
+
+    t->active = false;
+    leaveGroup(t,end,failed);
+    if ( t != &cam->track.pending && cam->track.pending.active && cam->track.pending.blocked && !timerisset(&cam->track.pending.freed) )
+        cam->track.pending.freed = *end;
+    if ( address > 0 && !failed )
+        blameTransaction(address,t,end);
+    if ( (ev = queueScriptEvent(SCRIPT_Transaction)) != NULL )
+    {
+        ev->cmd = (int16_t)t->cmd;
+        ev->address = (int8_t)address;
+        ev->failed = failed;
+        ev->tick = t->sent;
+        ev->latency = timeDiff(&t->sent,end);
+        ev->ack = t->acked.tv_sec ? timeDiff(&t->sent,&t->acked) : -1;
+        postScriptEvent();
+    }
+    if ( address > 0 )
+    {
+        T_IntervalCommand *c = &Interval.cmd[(t->cmd > 0 && t->cmd < RPL_Address) ? t->cmd : 0];
+
+        Interval.cam[address].transactions++;
+        countSlo(address,t,end,failed);
+        c->cnt++;
+        if ( failed )
+        {
+            Interval.cam[address].errors++;
+            c->errors++;
+        }
+        else
+        {
+            histAdd(&Interval.cam[address].done,timeDiff(&t->sent,end));
+            histAdd(&c->done,timeDiff(&t->sent,end));
+        }
+        if ( shadow.uart )
+        {
+            // the same for the comparison with the shadow camera
+            c = &ShadowPrimary[c - Interval.cmd];
+            c->cnt++;
+            if ( failed )
+                c->errors++;
+            else
+                histAdd(&c->done,timeDiff(&t->sent,end));
+        }
+        if ( Hints )
+        {
+            i = hintClass(t);
+            if ( !failed )
+            {
+                // a reply without ACK (inquiry) is the ACK as well
+                if ( t == &cam->track.pending )
+                    addHint(&HintAck[address][i],timeDiff(&t->sent,end));
+                addHint(&HintDone[address][i],timeDiff(&t->sent,end));
+            }
+            HintFailed[address][HintCount[address]++ % HINT_WINDOW] = failed;
+            publishHint(address,end);
+        }
+    }
+    trackInitStage(address,t,end,failed);
+}
+
+/* A transaction ends without any reply: the next command was sent before, or
+ * the sockets were cleared. It fails its group, is bad for the objectives and
+ * counts as failed in the latency hints.
+ */
+static void dropTransaction ( int address, T_Transaction *t, const struct timeval *now )
+{
+    t->active = false;
+    leaveGroup(t,NULL,true);
+    if ( address > 0 )
+    {
+        countSlo(address,t,NULL,true);
+        if ( Hints )
+        {
+            HintFailed[address][HintCount[address]++ % HINT_WINDOW] = true;
+            publishHint(address,now);
+        }
+    }
+}
+
+/* A finished transaction may end a stage of the initialisation of the chain.
+ * The stages are only tracked after the AddressSet broadcast: an IF_Clear,
+ * Power on or inquiry before it isn't part of an initialisation, and its
+ * stage would be logged without a ChainStart.
+ */
+static void trackInitStage ( int address, const T_Transaction *t, const struct timeval *end, bool failed )
+{
+    T_Camera *cam = &cameras[address];
+    int i;
+
+    if ( !ChainStarted )
+        return;
+    if ( t->cmd == CMD_IfClear )
+    {
+        if ( address == 0 )
+        {
+            for ( i=1; i<=ChainSize; i++ )
+                if ( cameras[i].init[INIT_IfClear].duration < 0 )
+                    finishInitStage(i,INIT_IfClear,&t->sent,end,failed);
+        }
+        else if ( cam->init[INIT_IfClear].duration < 0 )
+            finishInitStage(address,INIT_IfClear,&t->sent,end,failed);
+    }
+    else if ( t->cmd == CMD_Power && t->param == VISCA_ON )
+    {
+        if ( cam->init[INIT_Power].duration < 0 )
+            finishInitStage(address,INIT_Power,&t->sent,end,failed);
+    }
+    else if ( isInquiry(t->cmd) && cam->init[INIT_Inquiry].duration < 0 )
+    {
+        finishInitStage(address,INIT_Inquiry,&t->sent,end,failed);
+    }
+}
+
+/* Keep a frame of the CAM line for blameTransaction().
+ */
+static void addTimeline ( const T_VISCAInterface *interface )
+{
+    T_Frame *f = &Timeline[TimelineHead++ % TIMELINE_FRAMES];
+
+    f->start = interface->received;
+    f->num = interface->num;
+    f->address = interface->valid ? interface->address : -1;
+}
+
+/* Split the latency of a completed transaction of a camera. The reply is the
+ * last frame of the timeline. In this order, each part at most the rest:
+ *
+ * - wire:   the command on the line at 9600 baud
+ * - socket: both sockets were in use, until one was freed
+ * - line:   the CAM line was busy with frames of the same camera directly
+ *           before the reply, after the command was received
+ * - chain:  the same for frames of other cameras (or bad frames)
+ * - camera: the rest
+ *
+ * The blame is added per command and camera. A late transaction is logged as
+ * span "HH:MM:SS[mmmm] SPN: blame         camN  {dddd ms} ...".
+ */
+static void blameTransaction ( int address, const T_Transaction *t, const struct timeval *end )
+{
+    const T_Frame *f;
+    T_Blame *b[2];
+    long total, rest, wire, socket, line = 0, chain = 0, part;
+    struct timeval floor;
+    long cursor, start, stop;
+    int i;
+
+    total = timeDiffUs(&t->sent,end);
+    if ( total < 0 )
+        return;
+    rest = total;
+    wire = (long)t->num * VISCA_BYTE_TIME;
+    if ( wire > rest )
+        wire = rest;
+    rest -= wire;
+    socket = 0;
+    if ( t->blocked )
+        socket = t->freed.tv_sec ? timeDiffUs(&t->sent,&t->freed) - wire : rest;
+    if ( socket < 0 )
+        socket = 0;
+    if ( socket > rest )
+        socket = rest;
+    rest -= socket;
+
+    /* walk back the frames while the line was busy, all times relative to
+     * the end of the command
      */
-    rc = v24SetParameters(intf->uart, V24_B9600, V24_8BIT, V24_NONE);
-    if ( rc != V24_E_OK )
+    floor = t->sent;
+    cursor = total - wire;
+    for ( i=2; i<=TIMELINE_FRAMES && i<=(int)TimelineHead && cursor>0; i++ )
     {
-        dumpErrorMessage(rc);
-        v24ClosePort(intf->uart);
-        return false;
+        f = &Timeline[(TimelineHead-i) % TIMELINE_FRAMES];
+        start = timeDiffUs(&floor,&f->start) - wire;
+        stop = start + (long)f->num*VISCA_BYTE_TIME;
+        if ( stop + VISCA_BYTE_TIME < cursor )
+            break;                      // the line was idle before
+        if ( start >= cursor )
+            continue;
+        part = cursor - (start > 0 ? start : 0);
+        if ( f->address == address )
+            line += part;
+        else
+            chain += part;
+        cursor = start;
     }
-    if ( MyTimeOut > 0 )
+    if ( line > rest )
+        line = rest;
+    rest -= line;
+    if ( chain > rest )
+        chain = rest;
+    rest -= chain;
+
+    b[0] = &BlameCam[address];
+    b[1] = &BlameCmd[(t->cmd > 0 && t->cmd < RPL_Address) ? t->cmd : 0];
+    for ( i=0; i<2; i++ )
     {
-        rc=v24SetTimeouts(intf->uart,MyTimeOut*10);
-        if ( rc==V24_E_NOT_IMPLEMENTED )
-            fputs("INFO: setup of timeout is not available!\n",stderr);
-        else if ( rc!=V24_E_OK )
+        b[i]->cnt++;
+        b[i]->total += total;
+        b[i]->wire += wire;
+        b[i]->socket += socket;
+        b[i]->line += line;
+        b[i]->chain += chain;
+        b[i]->camera += rest;
+    }
+    if ( total/1000 > BLAME_LATE && !Quiet )
+        printf("%s SPN: blame         cam%d  {%5ld ms} wire=%ld socket=%ld line=%ld chain=%ld camera=%ld [ms] - %s\n",
+               logTime(&t->sent,false),address,total/1000,wire/1000,socket/1000,line/1000,chain/1000,rest/1000,
+               SequenceNames[(t->cmd > 0 && t->cmd < RPL_Address) ? t->cmd : 0]);
+}
+
+/* Dump the blame of a camera or command: the mean latency and the share of
+ * each part.
+ */
+static void dumpBlame ( const char *name, const T_Blame *b )
+{
+    double total = b->total ? (double)b->total : 1.0;
+
+    printf("~~~~~~~~~~~~~~~~~~~ blame %-22s n=%u done=%.1f [ms] | wire=%.0f%% socket=%.0f%% line=%.0f%% chain=%.0f%% camera=%.0f%%\n",
+           name,b->cnt,b->total/1000.0/b->cnt,
+           100.0*b->wire/total,100.0*b->socket/total,100.0*b->line/total,
+           100.0*b->chain/total,100.0*b->camera/total);
+}
+
+/* Add a command to a group. If the same command was sent to another camera
+ * within GROUP_WINDOW, the transaction joins this group. Otherwise the command
+ * opens a new group. A group with only one member isn't reported. A
+ * broadcast is a group of its own.
+ */
+static void joinGroup ( int address, T_Transaction *t, const T_VISCAInterface *interface )
+{
+    T_Group *g;
+    int num = interface->num-1;
+
+    t->group = -1;
+    if ( GroupOpen >= 0 && !interface->broadcast )
+    {
+        g = &groups[GroupOpen];
+        if ( g->active && !g->broadcast && g->num == num
+             && !(g->members & (1u << address))
+             && timeDiff(&g->start,&interface->received) <= GROUP_WINDOW
+             && memcmp(g->data,&interface->buffer[1],num) == 0 )
         {
-            dumpErrorMessage(rc);
-            v24ClosePort(intf->uart);
-            return false;
+            g->members |= 1u << address;
+            g->cnt++;
+            g->outstanding++;
+            t->group = GroupOpen;
+            return;
+        }
+    }
+
+    /* open a new group. The slot used is the oldest one. If this group is
+     * still active, it's lost.
+     */
+    if ( GroupOpen >= 0 && groups[GroupOpen].active && groups[GroupOpen].outstanding == 0 )
+        finishGroup(&groups[GroupOpen]);
+    g = &groups[GroupNext];
+    if ( g->active )
+    {
+        if ( g->cnt > 1 || g->broadcast )
+            GroupLost++;
+        if ( g->outstanding > 0 && timeDiff(&g->start,&interface->received) < GROUP_TIMEOUT )
+            fputs("warning: joinGroup(): too many open groups\n", stderr);
+    }
+    memset(g,0,sizeof(T_Group));
+    g->active = true;
+    g->broadcast = interface->broadcast;
+    g->num = num;
+    memcpy(g->data,&interface->buffer[1],num);
+    g->members = 1u << address;
+    g->cnt = g->outstanding = 1;
+    g->start = interface->received;
+    t->group = GroupOpen = GroupNext;
+    GroupNext = (GroupNext+1) % MAX_GROUPS;
+}
+
+/* A member transaction of a group is finished. Without a `end`, the
+ * transaction is abandoned and the group can't be reported.
+ */
+static void leaveGroup ( T_Transaction *t, const struct timeval *end, bool failed )
+{
+    T_Group *g;
+    int idx = t->group;
+
+    if ( idx < 0 )
+        return;
+    g = &groups[idx];
+    t->group = -1;
+    if ( !g->active )
+        return;
+    if ( !end )
+    {
+        if ( g->cnt > 1 || g->broadcast )
+            GroupLost++;
+        g->active = false;
+        return;
+    }
+    if ( failed )
+        g->failed = true;
+    if ( g->outstanding == g->cnt )
+        g->first = *end;
+    g->last = *end;
+    if ( --g->outstanding > 0 )
+        return;
+    // more members may join an open group
+    if ( idx == GroupOpen && timeDiff(&g->start,end) <= GROUP_WINDOW )
+        return;
+    finishGroup(g);
+}
+
+/* All members of a group are finished. The completion time of the group and
+ * the spread of the members are added to the histograms. A group expired with
+ * outstanding members is failed, it isn't added to the histograms.
+ */
+static void finishGroup ( T_Group *g )
+{
+    long completion, spread;
+    char name[20], missing[24] = "";
+
+    g->active = false;
+    if ( g->cnt < 2 && !g->broadcast )
+        return;
+    GroupCnt++;
+    if ( g->outstanding > 0 )
+    {
+        g->failed = true;
+        snprintf(missing,sizeof(missing)," (%d missing)",g->outstanding);
+    }
+    if ( g->failed )
+        GroupFailed++;
+    completion = timeDiff(&g->start,&g->last);
+    if ( g->outstanding == 0 )
+        histAdd(&GroupCompletion,completion);
+    if ( g->broadcast )
+        strcpy(name,"bcast");   // the chain returns a single broadcast
+    else
+    {
+        spread = timeDiff(&g->first,&g->last);
+        if ( g->outstanding == 0 )
+            histAdd(&GroupSpread,spread);
+        snprintf(name,sizeof(name),"cams=%d",g->cnt);
+    }
+    if ( !Quiet )
+        printf("%s SPN: group         %-7s{%5ld ms} %s%s\n",logTime(&g->start,false),name,completion,
+                   g->failed?"FAILED":"ok",missing);
+}
+
+/* Finish the groups on the tick, not only when the next group is opened: a
+ * group without outstanding members once its window is over, a group with
+ * outstanding members after GROUP_TIMEOUT, the missing members fail it. At
+ * the `end` of a capture, the window isn't waited for.
+ */
+static void expireGroups ( const struct timeval *now, bool end )
+{
+    T_Group *g;
+    long age;
+    int i;
+
+    for ( i=0; i<MAX_GROUPS; i++ )
+    {
+        g = &groups[i];
+        if ( !g->active )
+            continue;
+        age = timeDiff(&g->start,now);
+        if ( g->outstanding == 0 && (end || i != GroupOpen || age > GROUP_WINDOW) )
+            finishGroup(g);
+        else if ( g->outstanding > 0 && !end && age >= GROUP_TIMEOUT )
+        {
+            if ( g->outstanding == g->cnt )
+                g->first = *now;
+            g->last = *now;
+            finishGroup(g);
+        }
+    }
+}
+
+/* Start the tracking of a new initialisation of the chain. This is triggered
+ * by the AddressSet broadcast. Without a `start`, all data is cleared.
+ */
+static void resetChain ( const struct timeval *start )
+{
+    int i, j;
+
+    for ( i=0; i<=VISCA_MAX_CAMERAS; i++ )
+    {
+        for ( j=0; j<INIT_MAX_STAGES; j++ )
+        {
+            cameras[i].init[j].duration = -1;
+            cameras[i].init[j].slow = false;
+            cameras[i].init[j].failed = false;
+        }
+        cameras[i].ready = -1;
+    }
+    ChainSize = 0;
+    ChainReady = -1;
+    InitSlow = InitFailed = 0;
+    if ( start )
+    {
+        ChainStart = *start;
+        ChainStarted = true;
+    }
+    else
+        ChainStarted = false;
+}
+
+/* A stage of the initialisation is finished. The stage is logged as "span"
+ * with the start timestamp, the name, the address and the duration. The
+ * address 0 is used for the whole chain.
+ *
+ * "HH:MM:SS[mmmm] SPN: init.ssssss camN {dddd ms} status"
+ */
+static void finishInitStage ( int address, int stage, const struct timeval *start, const struct timeval *end, bool failed )
+{
+    T_InitStage *s = &cameras[address].init[stage];
+    long duration;
+    int i;
+
+    duration = timeDiff(start,end);
+    if ( failed )
+    {
+        s->failed = true;
+        InitFailed++;
+    }
+    else
+    {
+        s->duration = duration;
+        if ( duration > InitSlowLimit[stage] )
+        {
+            s->slow = true;
+            InitSlow++;
         }
+    }
+    if ( !Quiet )
+    {
+        printf("%s SPN: init.%-8s ",logTime(start,false),InitStageNames[stage]);
+        if ( address )
+            printf("cam%d  ",address);
         else
-            fprintf(stderr,"INFO: timeout is set to %dsec\n",MyTimeOut);
+            printf("chain ");
+        printf("{%5ld ms} %s\n",duration,failed?"FAILED":(s->slow?"SLOW":"ok"));
+    }
+
+    /* the first successful inquiry marks the camera as ready. The chain is
+     * ready, if all cameras reported by the address reply are ready.
+     */
+    if ( stage!=INIT_Inquiry || failed || !ChainStarted || address==0 )
+        return;
+    cameras[address].ready = timeDiff(&ChainStart,end);
+    if ( !Quiet )
+        printf("%s SPN: init.ready    cam%d  {%5ld ms}\n",logTime(&ChainStart,false),address,cameras[address].ready);
+    if ( ChainSize == 0 || ChainReady >= 0 )
+        return;
+    duration = 0;
+    for ( i=1; i<=ChainSize; i++ )
+    {
+        if ( cameras[i].ready < 0 )
+            return;
+        if ( cameras[i].ready > duration )
+            duration = cameras[i].ready;
+    }
+    ChainReady = duration;
+    if ( !Quiet )
+        printf("%s SPN: init.ready    chain {%5ld ms} %d cameras\n",logTime(&ChainStart,false),ChainReady,ChainSize);
+}
+
+/* Dump the statistics. The first line holds the avarage reply times and the
+ * error counters. If a initialisation was seen, the per camera readiness
+ * follows in a second line. Cameras with a known model are listed as
+ * vendor/model/rom.
+ */
+static void dumpStatistics ( long sender_errors, long receiver_errors )
+{
+    char name[8];
+    int i, j;
+
+    if ( Quiet )
+        return;
+    printf("~~~~~~~~~~~~~~~~~~~ ack=%Lf (%ld) | done=%Lf (%ld) [ms] | unknown=%ld/%ld | errors=%ld/%ld\n",
+           avg_ack.current,avg_ack.cnt,
+           avg_done.current,avg_done.cnt,
+           sender.unknown,receiver.unknown,
+           sender_errors,receiver_errors);
+    if ( ChainStarted )
+    {
+        printf("~~~~~~~~~~~~~~~~~~~ init: chain=%ld (%d cams) [ms] | slow=%d | failed=%d",
+               ChainReady,ChainSize,InitSlow,InitFailed);
+        for ( i=1; i<=VISCA_MAX_CAMERAS; i++ )
+        {
+            if ( !cameras[i].present )
+                continue;
+            printf(" | cam%d=%ld [",i,cameras[i].ready);
+            for ( j=0; j<INIT_MAX_STAGES; j++ )
+                printf("%s%s=%ld%s",j?" ":"",InitStageNames[j],cameras[i].init[j].duration,
+                       cameras[i].init[j].failed?"!":(cameras[i].init[j].slow?"*":""));
+            printf("]");
+        }
+        printf("\n");
+    }
+    if ( Tsc.valid )
+        printf("~~~~~~~~~~~~~~~~~~~ clock: tsc %.3f GHz | calibrations=%ld | drift max %.1f [us] | offset max %.1f [us]\n",
+               1.0/Tsc.ns_per_tick,Tsc.calibrations,Tsc.drift/1000.0,Tsc.offset/1000.0);
+    if ( LoadLast[LINE_CTL].packets || LoadLast[LINE_CAM].packets )
+    {
+        printf("~~~~~~~~~~~~~~~~~~~ load:");
+        for ( i=0; i<MAX_LINES; i++ )
+            printf("%s %s bytes=%u (%.1f%%) packets=%u errors=%u cpu=%u [us] (%.3f%%)",i?" |":"",
+                   i==LINE_CTL?"CTL":"CAM",LoadLast[i].bytes,
+                   LoadLast[i].bytes*(double)VISCA_BYTE_TIME/(INTERVAL_LENGTH*10000.0),
+                   LoadLast[i].packets,LoadLast[i].errors,
+                   LoadLast[i].busy,LoadLast[i].busy/(INTERVAL_LENGTH*10000.0));
+        printf("\n");
+    }
+    if ( LoadLast[LINE_CTL].queued.cnt || LoadLast[LINE_CAM].queued.cnt )
+    {
+        printf("~~~~~~~~~~~~~~~~~~~ reader:");
+        for ( i=0; i<MAX_LINES; i++ )
+            printf("%s %s wakeups=%u queued p50/p99/max=%ld/%ld/%u [bytes] lag p50/p99/max=%ld/%ld/%u [us] alerts=%u",i?" |":"",
+                   i==LINE_CTL?"CTL":"CAM",LoadLast[i].queued.cnt,
+                   queuedPercentile(&LoadLast[i],50),queuedPercentile(&LoadLast[i],99),LoadLast[i].queued_max,
+                   lagPercentile(&LoadLast[i],50),lagPercentile(&LoadLast[i],99),LoadLast[i].lag_max,
+                   LoadLast[i].alerts);
+        printf("\n");
+    }
+    for ( i=1, j=0; i<=VISCA_MAX_CAMERAS; i++ )
+    {
+        if ( !cameras[i].version )
+            continue;
+        printf("%s cam%d=%4.4X/%4.4X/%4.4X",j++?" |":"~~~~~~~~~~~~~~~~~~~ models:",i,
+               cameras[i].vendor,cameras[i].model,cameras[i].rom);
     }
+    if ( j > 0 )
+        printf("\n");
+    if ( *ScriptFileName != '\0' )
+    {
+        printf("~~~~~~~~~~~~~~~~~~~ script: dropped=%ld/%ld/%ld | overrun=%ld/%ld/%ld | failed=%ld/%ld/%ld (packet/transaction/interval)\n",
+               ScriptDropped[SCRIPT_Packet],ScriptDropped[SCRIPT_Transaction],ScriptDropped[SCRIPT_Interval],
+               atomic_load(&ScriptOverrun[SCRIPT_Packet]),atomic_load(&ScriptOverrun[SCRIPT_Transaction]),
+               atomic_load(&ScriptOverrun[SCRIPT_Interval]),
+               atomic_load(&ScriptFailed[SCRIPT_Packet]),atomic_load(&ScriptFailed[SCRIPT_Transaction]),
+               atomic_load(&ScriptFailed[SCRIPT_Interval]));
+    }
+    if ( GroupCnt > 0 )
+    {
+        printf("~~~~~~~~~~~~~~~~~~~ groups=%ld | failed=%ld | lost=%ld | completion p50/p90/p99=%ld/%ld/%ld | spread p50/p90/p99=%ld/%ld/%ld [ms]\n",
+               GroupCnt,GroupFailed,GroupLost,
+               histPercentile(&GroupCompletion,50),histPercentile(&GroupCompletion,90),histPercentile(&GroupCompletion,99),
+               histPercentile(&GroupSpread,50),histPercentile(&GroupSpread,90),histPercentile(&GroupSpread,99));
+    }
+    if ( CacheTTL > 0 )
+    {
+        struct timeval now;
+        long elapsed;
+
+        getTime(&now);
+        elapsed = PrefetchStart.tv_sec ? timeDiff(&PrefetchStart,&now) : 0;
+        printf("~~~~~~~~~~~~~~~~~~~ cache: asks=%ld hits=%ld (%.1f%%) | prefetch=%ld used=%ld (%.1f%%) preempted=%ld lost=%ld | line=%ld [ms] (%.2f%%)\n",
+               CacheAsks,CacheHits,CacheAsks?100.0*CacheHits/CacheAsks:0.0,
+               PrefetchCnt,PrefetchUsed,PrefetchCnt?100.0*PrefetchUsed/PrefetchCnt:0.0,
+               PrefetchPreempted,PrefetchLost,
+               PrefetchLine/1000,elapsed>0?PrefetchLine/10.0/elapsed:0.0);
+    }
+    for ( i=1; i<=VISCA_MAX_CAMERAS; i++ )
+    {
+        if ( BlameCam[i].cnt == 0 )
+            continue;
+        snprintf(name,sizeof(name),"cam%d",i);
+        dumpBlame(name,&BlameCam[i]);
+    }
+    for ( i=0; i<RPL_Address; i++ )
+        if ( BlameCmd[i].cnt > 0 )
+            dumpBlame(SequenceNames[i],&BlameCmd[i]);
+    if ( PaceCeiling > 0 )
+        dumpPace();
+    if ( SloCount > 0 )
+        dumpSlo();
+    if ( shadow.uart )
+        dumpShadow();
+}
+
+/* Add a value in [ms] to a histogram. Negative values are counted as 0.
+ */
+static void histAdd ( T_Histogram *h, long value )
+{
+    h->bucket[histBucket(value)]++;
+    h->cnt++;
+}
+
+/* Return the bucket of a value in [ms].
+ */
+static int histBucket ( long value )
+{
+    int idx, e;
+
+    if ( value < HIST_LINEAR )
+        return (value < 0) ? 0 : (int)value;
+    for ( e=0; (value >> e) > 1; e++ )
+        ;
+    idx = HIST_LINEAR + (e-3)*HIST_SUBBUCKETS + (int)((value >> (e-2)) & (HIST_SUBBUCKETS-1));
+    return (idx >= HIST_BUCKETS) ? HIST_BUCKETS-1 : idx;
+}
+
+/* Return the lower bound of a bucket in [ms].
+ */
+static long histLowerBound ( int idx )
+{
+    int e;
+
+    if ( idx < HIST_LINEAR )
+        return idx;
+    e = 3 + (idx-HIST_LINEAR)/HIST_SUBBUCKETS;
+    return (long)(HIST_SUBBUCKETS + (idx-HIST_LINEAR)%HIST_SUBBUCKETS) << (e-2);
+}
+
+/* Return the percentile of a histogram in [ms]. The middle of the bucket is
+ * returned. If the histogram is empty, -1 is returned.
+ */
+static long histPercentile ( const T_Histogram *h, double percent )
+{
+    uint32_t rank, sum;
+    int i;
+
+    if ( h->cnt == 0 )
+        return -1;
+    rank = (uint32_t)ceil((double)h->cnt*percent/100.0);
+    if ( rank == 0 )
+        rank = 1;
+    for ( i=0, sum=0; i<HIST_BUCKETS-1; i++ )
+    {
+        sum += h->bucket[i];
+        if ( sum >= rank )
+            return (histLowerBound(i)+histLowerBound(i+1)-1)/2;
+    }
+    return histLowerBound(HIST_BUCKETS-1);
+}
+
+/* Add all buckets of `from` to the histogram `to`.
+ */
+static void histMerge ( T_Histogram *to, const T_Histogram *from )
+{
+    int i;
+
+    for ( i=0; i<HIST_BUCKETS; i++ )
+        to->bucket[i] += from->bucket[i];
+    to->cnt += from->cnt;
+}
+
+/* Count a received packet (or a bad one) in the interval statistics.
+ */
+static void countPacket ( T_VISCAInterface *interface, uint8_t rc )
+{
+    T_IntervalLine *l = &Interval.line[(interface==&sender) ? LINE_CTL : LINE_CAM];
+
+    if ( rc == VISCA_SUCCESS )
+    {
+        l->packets++;
+        l->bytes += interface->num;
+        if ( interface->cmd == 0 )
+            l->unknown++;
+    }
+    else if ( interface->cnt > 0 )
+        l->errors++;
+}
+
+/* Count a wake-up of the reader: the bytes queued in the kernel and the lag
+ * [us] between the wake-up and the read. The first wake-up of an
+ * interval with the queue above the watermark (-Q) is logged as span.
+ */
+static void countReader ( T_VISCAInterface *interface, int queued, long lag, const struct timeval *now )
+{
+    T_IntervalLine *l = &Interval.line[(interface==&sender) ? LINE_CTL : LINE_CAM];
+
+    histAdd(&l->queued,queued);
+    histAdd(&l->lag,lag/READER_LAG_UNIT);
+    if ( (uint32_t)queued > l->queued_max )
+        l->queued_max = (uint32_t)queued;
+    if ( lag > (long)l->lag_max )
+        l->lag_max = (uint32_t)lag;
+    if ( queued <= ReaderWatermark )
+        return;
+    if ( l->alerts++ == 0 )
+        printf("%s SPN: reader        %s   queued %d bytes (watermark %ld) lag %ld us\n",
+               logTime(now,false),interface->name,queued,ReaderWatermark,lag);
+}
+
+/* The bucket bound of a percentile may be above the largest queue seen.
+ */
+static long queuedPercentile ( const T_IntervalLine *l, int pct )
+{
+    long p = histPercentile(&l->queued,pct);
+
+    return (p > (long)l->queued_max) ? (long)l->queued_max : p;
+}
+
+/* Return a percentile of the lag in [us]. In the last bucket of the
+ * histogram, only the longest lag is known.
+ */
+static long lagPercentile ( const T_IntervalLine *l, int pct )
+{
+    long p = histPercentile(&l->lag,pct);
+
+    if ( p < 0 )
+        return p;
+    if ( p >= histLowerBound(HIST_BUCKETS-1) )
+        return (long)l->lag_max;
+    p *= READER_LAG_UNIT;
+    return (p > (long)l->lag_max) ? (long)l->lag_max : p;
+}
+
+/* Check if the current interval is over. If so, the interval is written to
+ * the store and a new one is started.
+ */
+static void checkInterval ( const struct timeval *now )
+{
+    int64_t start = (int64_t)now->tv_sec - (int64_t)now->tv_sec % INTERVAL_LENGTH;
+    T_ScriptEvent *ev;
+    double burn;
+    int i;
+
+    expireGroups(now,false);
+    if ( Interval.start == start )
+        return;
+    if ( Interval.start != 0 )
+    {
+        finishInterval(INTERVAL_LENGTH);
+        pushSlo(&Interval);
+        if ( Partials )
+            addPartial(&Interval);
+        else
+            writeStore(&Interval);
+        if ( (ev = queueScriptEvent(SCRIPT_Interval)) != NULL )
+        {
+            ev->tick.tv_sec = (time_t)Interval.start;
+            ev->tick.tv_usec = 0;
+            for ( i=0; i<MAX_LINES; i++ )
+            {
+                ev->packets[i] = Interval.line[i].packets;
+                ev->errors[i] = Interval.line[i].errors;
+            }
+            ev->transactions = 0;
+            for ( i=1; i<=VISCA_MAX_CAMERAS; i++ )
+                ev->transactions += Interval.cam[i].transactions;
+            ev->slo_burn = 0.0;
+            ev->slo_budget = 100.0;
+            for ( i=0; i<SloCount; i++ )
+            {
+                burn = burnSlo(Slo[i].sum_good[1],Slo[i].sum_total[1],Slo[i].objective);
+                if ( burn > ev->slo_burn )
+                    ev->slo_burn = burn;
+                burn = burnSlo(Slo[i].sum_good[SLO_WINDOWS-1],Slo[i].sum_total[SLO_WINDOWS-1],Slo[i].objective);
+                if ( 100.0*(1.0-burn) < ev->slo_budget )
+                    ev->slo_budget = 100.0*(1.0-burn);
+            }
+            postScriptEvent();
+        }
+    }
+    memset(&Interval,0,sizeof(T_Interval));
+    Interval.start = start;
+    LoadBusy[LINE_CTL] = sender.busy;
+    LoadBusy[LINE_CAM] = receiver.busy;
+}
+
+/* Complete the counters of the interval before it's written.
+ */
+static void finishInterval ( uint32_t duration )
+{
+    int i;
+
+    Interval.duration = duration;
+    Interval.intervals = 1;
+    Interval.line[LINE_CTL].busy = (uint32_t)(sender.busy - LoadBusy[LINE_CTL]);
+    Interval.line[LINE_CAM].busy = (uint32_t)(receiver.busy - LoadBusy[LINE_CAM]);
+    memcpy(LoadLast,Interval.line,sizeof(LoadLast));
+    for ( i=1; i<=VISCA_MAX_CAMERAS; i++ )
+    {
+        Interval.cam[i].vendor = cameras[i].vendor;
+        Interval.cam[i].model = cameras[i].model;
+        Interval.cam[i].rom = cameras[i].rom;
+        Interval.cam[i].limit = Pace[i].low;
+        Pace[i].low = (uint16_t)(Pace[i].limit*100.0);
+    }
+}
+
+/* Write the open interval to the store at the end of the capture (or the
+ * replay). It covers the time up to `end`.
+ */
+static void closeInterval ( const struct timeval *end )
+{
+    int64_t duration;
+
+    if ( Interval.start == 0 )
+        return;
+    duration = (int64_t)end->tv_sec - Interval.start;
+    if ( duration < 0 )
+        duration = 0;
+    if ( duration > INTERVAL_LENGTH )
+        duration = INTERVAL_LENGTH;
+    finishInterval((uint32_t)duration);
+    writeStore(&Interval);
+    memset(&Interval,0,sizeof(T_Interval));
+}
+
+/* Merge the interval `from` into `to`.
+ */
+static void mergeInterval ( T_Interval *to, const T_Interval *from )
+{
+    int i;
+
+    to->duration += from->duration;
+    to->intervals += from->intervals;
+    for ( i=0; i<MAX_LINES; i++ )
+    {
+        to->line[i].packets += from->line[i].packets;
+        to->line[i].bytes += from->line[i].bytes;
+        to->line[i].errors += from->line[i].errors;
+        to->line[i].unknown += from->line[i].unknown;
+        to->line[i].busy += from->line[i].busy;
+        to->line[i].alerts += from->line[i].alerts;
+        if ( from->line[i].queued_max > to->line[i].queued_max )
+            to->line[i].queued_max = from->line[i].queued_max;
+        if ( from->line[i].lag_max > to->line[i].lag_max )
+            to->line[i].lag_max = from->line[i].lag_max;
+        histMerge(&to->line[i].queued,&from->line[i].queued);
+        histMerge(&to->line[i].lag,&from->line[i].lag);
+    }
+    for ( i=0; i<=VISCA_MAX_CAMERAS; i++ )
+    {
+        if ( from->cam[i].model )
+        {
+            to->cam[i].vendor = from->cam[i].vendor;
+            to->cam[i].model = from->cam[i].model;
+            to->cam[i].rom = from->cam[i].rom;
+        }
+        if ( from->cam[i].limit && (!to->cam[i].limit || from->cam[i].limit < to->cam[i].limit) )
+            to->cam[i].limit = from->cam[i].limit;
+        to->cam[i].transactions += from->cam[i].transactions;
+        to->cam[i].errors += from->cam[i].errors;
+        histMerge(&to->cam[i].ack,&from->cam[i].ack);
+        histMerge(&to->cam[i].done,&from->cam[i].done);
+    }
+    for ( i=0; i<RPL_Address; i++ )
+    {
+        to->cmd[i].cnt += from->cmd[i].cnt;
+        to->cmd[i].errors += from->cmd[i].errors;
+        histMerge(&to->cmd[i].done,&from->cmd[i].done);
+    }
+    for ( i=0; i<SLO_MAX; i++ )
+    {
+        if ( from->slo[i].id == 0 || (to->slo[i].id != 0 && to->slo[i].id != from->slo[i].id) )
+            continue;
+        to->slo[i].id = from->slo[i].id;
+        to->slo[i].good += from->slo[i].good;
+        to->slo[i].total += from->slo[i].total;
+    }
+}
+
+/* Open (or create) the round robin store and map it into memory. The size of
+ * the file is fixed by `RrdLayout`. An existing store must have the same
+ * layout.
+ */
+static bool openStore ( const char *FileName, bool create )
+{
+    T_RrdHeader *hdr;
+    T_RrdHeader layout;
+    uint64_t offset;
+    struct stat st;
+    struct timespec ts;
+    int fd, i;
+
+    memset(&layout,0,sizeof(layout));
+    strcpy(layout.magic,RRD_MAGIC);
+    layout.slot_size = sizeof(T_Interval);
+    layout.levels = RRD_LEVELS;
+    offset = RRD_HEADER_SIZE;
+    for ( i=0; i<RRD_LEVELS; i++ )
+    {
+        layout.level[i] = RrdLayout[i];
+        layout.level[i].offset = offset;
+        offset += (uint64_t)RrdLayout[i].slots*sizeof(T_Interval);
+    }
+    RrdSize = (size_t)offset;
+
+    fd = open(FileName,create ? O_RDWR|O_CREAT : O_RDONLY,0644);
+    if ( fd < 0 )
+    {
+        fprintf(stderr,"ERROR: can't open store `%s'!\n",FileName);
+        return false;
+    }
+    if ( fstat(fd,&st) < 0 )
+    {
+        close(fd);
+        return false;
+    }
+    if ( st.st_size == 0 && create )
+    {
+        if ( ftruncate(fd,(off_t)RrdSize) < 0 )
+        {
+            fprintf(stderr,"ERROR: can't allocate %lu bytes for store `%s'!\n",(unsigned long)RrdSize,FileName);
+            close(fd);
+            return false;
+        }
+        fprintf(stderr,"INFO: store `%s' created with %lu bytes\n",FileName,(unsigned long)RrdSize);
+    }
+    else if ( st.st_size != (off_t)RrdSize )
+    {
+        fprintf(stderr,"ERROR: store `%s' has a different size!\n",FileName);
+        close(fd);
+        return false;
+    }
+    Rrd = mmap(NULL,RrdSize,create ? PROT_READ|PROT_WRITE : PROT_READ,MAP_SHARED,fd,0);
+    close(fd);
+    if ( Rrd == MAP_FAILED )
+    {
+        Rrd = NULL;
+        fputs("ERROR: openStore(): mmap failed\n",stderr);
+        return false;
+    }
+    hdr = (T_RrdHeader *)Rrd;
+    if ( create && hdr->magic[0] == '\0' )
+        memcpy(hdr,&layout,offsetof(T_RrdHeader,id));
+    if ( memcmp(hdr,&layout,offsetof(T_RrdHeader,id)) != 0 )
+    {
+        fprintf(stderr,"ERROR: store `%s' has a different layout!\n",FileName);
+        closeStore();
+        return false;
+    }
+    if ( create && hdr->id == 0 )
+    {
+        // identifies the store in the cache of a replay (see replayCached())
+        clock_gettime(CLOCK_REALTIME,&ts);
+        hdr->id = hashFNV(hashFNV(FNV_OFFSET,&ts,sizeof(ts)),FileName,strlen(FileName)) ^ (uint64_t)getpid();
+    }
+    return true;
+}
+
+/* Merge a finished interval into the slot of each level. If the slot holds
+ * data of an older period, it's cleared first.
+ */
+static void writeStore ( const T_Interval *interval )
+{
+    const T_RrdHeader *hdr = (const T_RrdHeader *)Rrd;
+    T_Interval *slot;
+    int64_t start;
+    int i;
+
+    if ( !Rrd )
+        return;
+    for ( i=0; i<RRD_LEVELS; i++ )
+    {
+        start = interval->start - interval->start % hdr->level[i].step;
+        slot = (T_Interval *)(Rrd + hdr->level[i].offset)
+               + (start / hdr->level[i].step) % hdr->level[i].slots;
+        if ( slot->start != start )
+        {
+            memset(slot,0,sizeof(T_Interval));
+            slot->start = start;
+        }
+        mergeInterval(slot,interval);
+    }
+}
+
+/* Take back an interval written by writeStore() with `duration` [s], but
+ * without counters: the interval open at the end of a cached replay, which is
+ * continued by the next one.
+ */
+static void retractStore ( int64_t start, uint32_t duration )
+{
+    const T_RrdHeader *hdr = (const T_RrdHeader *)Rrd;
+    T_Interval *slot;
+    int64_t first;
+    int i;
+
+    if ( !Rrd )
+        return;
+    for ( i=0; i<RRD_LEVELS; i++ )
+    {
+        first = start - start % hdr->level[i].step;
+        slot = (T_Interval *)(Rrd + hdr->level[i].offset)
+               + (first / hdr->level[i].step) % hdr->level[i].slots;
+        if ( slot->start != first || slot->intervals == 0 )
+            continue;                   // already overwritten
+        slot->duration = (slot->duration > duration) ? slot->duration - duration : 0;
+        slot->intervals--;
+    }
+}
+
+static void closeStore ( void )
+{
+    if ( Rrd )
+    {
+        msync(Rrd,RrdSize,MS_ASYNC);
+        munmap(Rrd,RrdSize);
+    }
+    Rrd = NULL;
+}
+
+/* Create the table of the latency hints (-M) in a (shared memory) file. The
+ * file is rewritten, the magic is set after the layout.
+ */
+static bool openHints ( const char *FileName )
+{
+    T_HintTable *table;
+    int fd, i, c;
+
+    fd = open(FileName,O_RDWR|O_CREAT,0644);
+    if ( fd < 0 )
+    {
+        fprintf(stderr,"ERROR: can't open hint table `%s'!\n",FileName);
+        return false;
+    }
+    if ( ftruncate(fd,0) < 0 || ftruncate(fd,(off_t)sizeof(T_HintTable)) < 0 )
+    {
+        fprintf(stderr,"ERROR: can't allocate %lu bytes for hint table `%s'!\n",(unsigned long)sizeof(T_HintTable),FileName);
+        close(fd);
+        return false;
+    }
+    table = mmap(NULL,sizeof(T_HintTable),PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+    close(fd);
+    if ( table == MAP_FAILED )
+    {
+        fputs("ERROR: openHints(): mmap failed\n",stderr);
+        return false;
+    }
+    table->size = sizeof(T_HintTable);
+    table->record = sizeof(T_HintCamera);
+    table->cameras = VISCA_MAX_CAMERAS;
+    table->classes = HINT_MAX_CLASSES;
+    table->window = HINT_WINDOW;
+    table->pid = (uint32_t)getpid();
+    for ( i=0; i<=VISCA_MAX_CAMERAS; i++ )
+        for ( c=0; c<HINT_MAX_CLASSES; c++ )
+            table->cam[i].ack_p50[c] = table->cam[i].ack_p99[c] =
+            table->cam[i].done_p50[c] = table->cam[i].done_p99[c] = HINT_NONE;
+    atomic_thread_fence(memory_order_release);
+    memcpy(table->magic,HINT_MAGIC,sizeof(table->magic));
+    Hints = table;
+    fprintf(stderr,"INFO: hint table `%s' with %lu bytes\n",FileName,(unsigned long)sizeof(T_HintTable));
+    return true;
+}
+
+/* A reader sees pid 0 after the stop. The records stay.
+ */
+static void closeHints ( void )
+{
+    if ( Hints )
+    {
+        Hints->pid = 0;
+        munmap(Hints,sizeof(T_HintTable));
+    }
+    Hints = NULL;
+}
+
+static int hintClass ( const T_Transaction *t )
+{
+    if ( isStop(t) )
+        return HINT_Stops;
+    return isInquiry(t->cmd) ? HINT_Inquiries : HINT_Commands;
+}
+
+/* Add a value in [ms] to a rolling window, the oldest falls out.
+ */
+static void addHint ( T_HintWindow *w, long value )
+{
+    uint8_t *slot = &w->ring[w->head++ % HINT_WINDOW];
+
+    if ( w->hist.cnt >= HINT_WINDOW )
+    {
+        w->hist.bucket[*slot]--;
+        w->hist.cnt--;
+    }
+    *slot = (uint8_t)histBucket(value);
+    w->hist.bucket[*slot]++;
+    w->hist.cnt++;
+}
+
+/* Build the record of a camera and write it into the table.
+ */
+static void publishHint ( int address, const struct timeval *now )
+{
+    const T_Camera *cam = &cameras[address];
+    T_HintCamera v;
+    long p;
+    int c, i, n, failed;
+
+    memset(&v,0,sizeof(v));
+    for ( c=0; c<HINT_MAX_CLASSES; c++ )
+    {
+        p = histPercentile(&HintAck[address][c].hist,50);
+        v.ack_p50[c] = (p < 0) ? HINT_NONE : (uint16_t)((p < HINT_NONE) ? p : HINT_NONE-1);
+        p = histPercentile(&HintAck[address][c].hist,99);
+        v.ack_p99[c] = (p < 0) ? HINT_NONE : (uint16_t)((p < HINT_NONE) ? p : HINT_NONE-1);
+        p = histPercentile(&HintDone[address][c].hist,50);
+        v.done_p50[c] = (p < 0) ? HINT_NONE : (uint16_t)((p < HINT_NONE) ? p : HINT_NONE-1);
+        p = histPercentile(&HintDone[address][c].hist,99);
+        v.done_p99[c] = (p < 0) ? HINT_NONE : (uint16_t)((p < HINT_NONE) ? p : HINT_NONE-1);
+    }
+    if ( cam->track.pending.active )
+        v.sockets |= 1;
+    for ( i=1; i<=VISCA_SOCKETS; i++ )
+    {
+        if ( cam->track.socket[i].active )
+        {
+            v.sockets |= (uint8_t)(1 << i);
+            v.busy++;
+        }
+    }
+    n = (HintCount[address] < HINT_WINDOW) ? (int)HintCount[address] : HINT_WINDOW;
+    for ( i=failed=0; i<n; i++ )
+        failed += HintFailed[address][i];
+    v.errors = n ? (uint16_t)(failed*10000/n) : 0;
+    v.transactions = HintCount[address];
+    v.updated = (int64_t)now->tv_sec*1000000 + now->tv_usec;
+    writeHint(&Hints->cam[address],&v);
+}
+
+/* The writer of the seqlock. There's a single writer, so `seq` isn't read
+ * back from the table.
+ */
+static void writeHint ( T_HintCamera *h, const T_HintCamera *v )
+{
+    unsigned seq = atomic_load_explicit(&h->seq,memory_order_relaxed);
+
+    atomic_store_explicit(&h->seq,seq+1,memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy((char *)h + offsetof(T_HintCamera,ack_p50),(const char *)v + offsetof(T_HintCamera,ack_p50),
+           sizeof(T_HintCamera) - offsetof(T_HintCamera,ack_p50));
+    atomic_store_explicit(&h->seq,seq+2,memory_order_release);
+}
+
+/* The reader of the seqlock, as other processes should do it. Return the
+ * number of retries, or -1 if no consistent copy was read: the writer has
+ * stopped (pid 0) in the middle of a write, or HINT_READ_TRIES were exceeded,
+ * e.g. the writer died while `seq` was odd. While `seq` is odd, the CPU is
+ * given up, the writer may wait for it.
+ */
+static int readHint ( const T_HintTable *table, int address, T_HintCamera *v )
+{
+    T_HintCamera *h = (T_HintCamera *)&table->cam[address];
+    unsigned seq;
+    int retries;
+
+    for ( retries=0; retries<HINT_READ_TRIES; retries++ )
+    {
+        seq = atomic_load_explicit(&h->seq,memory_order_acquire);
+        if ( !(seq & 1) )
+        {
+            memcpy((char *)v + offsetof(T_HintCamera,ack_p50),(const char *)h + offsetof(T_HintCamera,ack_p50),
+                   sizeof(T_HintCamera) - offsetof(T_HintCamera,ack_p50));
+            atomic_thread_fence(memory_order_acquire);
+            if ( atomic_load_explicit(&h->seq,memory_order_relaxed) == seq )
+            {
+                atomic_init(&v->seq,seq);
+                return retries;
+            }
+        }
+        else if ( table->pid == 0 )
+            return -1;
+        else
+            sched_yield();              // a preempted writer may need this CPU
+    }
+    return -1;
+}
+
+/* Query the last `range` seconds. The finest level holding the whole range is
+ * used. Each slot is dumped in a line, followed by the totals per camera and
+ * per command.
+ */
+static void queryStore ( long range )
+{
+    const T_RrdHeader *hdr = (const T_RrdHeader *)Rrd;
+    const T_Interval *slot;
+    T_Interval total;
+    T_IntervalCamera all;               // all cameras of a slot
+    struct timeval tick;
+    int64_t now, from, start;
+    int i, j, cams, level;
+
+    now = (int64_t)time(NULL);
+    for ( level=0; level<RRD_LEVELS-1; level++ )
+        if ( (int64_t)hdr->level[level].step*hdr->level[level].slots >= range )
+            break;
+    from = now - range;
+    from -= from % hdr->level[level].step;
+    memset(&total,0,sizeof(total));
+    tick.tv_usec = 0;
+    printf("level %us: %ld..%ld\n",hdr->level[level].step,(long)from,(long)now);
+    for ( start=from; start<=now; start+=hdr->level[level].step )
+    {
+        slot = (const T_Interval *)(Rrd + hdr->level[level].offset)
+               + (start / hdr->level[level].step) % hdr->level[level].slots;
+        if ( slot->start != start )
+            continue;
+        mergeInterval(&total,slot);
+        memset(&all,0,sizeof(all));
+        for ( i=1; i<=VISCA_MAX_CAMERAS; i++ )
+        {
+            all.transactions += slot->cam[i].transactions;
+            histMerge(&all.ack,&slot->cam[i].ack);
+            histMerge(&all.done,&slot->cam[i].done);
+        }
+        tick.tv_sec = (time_t)start;
+        printf("%s CTL: %6u/%u CAM: %6u/%u - transactions=%u ack p50/p99=%ld/%ld done p50/p99=%ld/%ld [ms]\n",
+               logTime(&tick,true),
+               slot->line[LINE_CTL].packets,slot->line[LINE_CTL].errors,
+               slot->line[LINE_CAM].packets,slot->line[LINE_CAM].errors,
+               all.transactions,
+               histPercentile(&all.ack,50),histPercentile(&all.ack,99),
+               histPercentile(&all.done,50),histPercentile(&all.done,99));
+    }
+    printf("~~~~~~~~~~~~~~~~~~~ %u intervals | CTL: %u packets %u errors %u unknown %u bytes %u [ms] cpu | CAM: %u packets %u errors %u unknown %u bytes %u [ms] cpu\n",
+           total.intervals,
+           total.line[LINE_CTL].packets,total.line[LINE_CTL].errors,total.line[LINE_CTL].unknown,
+           total.line[LINE_CTL].bytes,total.line[LINE_CTL].busy/1000,
+           total.line[LINE_CAM].packets,total.line[LINE_CAM].errors,total.line[LINE_CAM].unknown,
+           total.line[LINE_CAM].bytes,total.line[LINE_CAM].busy/1000);
+    if ( total.line[LINE_CTL].queued.cnt || total.line[LINE_CAM].queued.cnt )
+        printf("~~~~~~~~~~~~~~~~~~~ reader CTL: queued p99/max=%ld/%u [bytes] lag p99/max=%ld/%u [us] alerts=%u | CAM: queued p99/max=%ld/%u [bytes] lag p99/max=%ld/%u [us] alerts=%u\n",
+               queuedPercentile(&total.line[LINE_CTL],99),total.line[LINE_CTL].queued_max,
+               lagPercentile(&total.line[LINE_CTL],99),total.line[LINE_CTL].lag_max,total.line[LINE_CTL].alerts,
+               queuedPercentile(&total.line[LINE_CAM],99),total.line[LINE_CAM].queued_max,
+               lagPercentile(&total.line[LINE_CAM],99),total.line[LINE_CAM].lag_max,total.line[LINE_CAM].alerts);
+    for ( i=1; i<=VISCA_MAX_CAMERAS; i++ )
+    {
+        if ( total.cam[i].transactions == 0 )
+            continue;
+        printf("~~~~~~~~~~~~~~~~~~~ cam%d: model=%4.4X/%4.4X rom=%4.4X limit=%.2f transactions=%u errors=%u | ack p50/p90/p99=%ld/%ld/%ld | done p50/p90/p99=%ld/%ld/%ld [ms]\n",
+               i,total.cam[i].vendor,total.cam[i].model,total.cam[i].rom,total.cam[i].limit/100.0,
+               total.cam[i].transactions,total.cam[i].errors,
+               histPercentile(&total.cam[i].ack,50),histPercentile(&total.cam[i].ack,90),histPercentile(&total.cam[i].ack,99),
+               histPercentile(&total.cam[i].done,50),histPercentile(&total.cam[i].done,90),histPercentile(&total.cam[i].done,99));
+    }
+    /* cameras of the same model and firmware are summed up in the first
+     * camera of that kind; unknown models are not aggregated
+     */
+    for ( i=1; i<=VISCA_MAX_CAMERAS; i++ )
+    {
+        if ( total.cam[i].transactions == 0 || total.cam[i].model == 0 )
+            continue;
+        memcpy(&all,&total.cam[i],sizeof(all));
+        cams = 1;
+        for ( j=i+1; j<=VISCA_MAX_CAMERAS; j++ )
+        {
+            if ( total.cam[j].vendor != all.vendor || total.cam[j].model != all.model || total.cam[j].rom != all.rom )
+                continue;
+            all.transactions += total.cam[j].transactions;
+            all.errors += total.cam[j].errors;
+            histMerge(&all.ack,&total.cam[j].ack);
+            histMerge(&all.done,&total.cam[j].done);
+            total.cam[j].model = 0;
+            cams++;
+        }
+        printf("~~~~~~~~~~~~~~~~~~~ model %4.4X/%4.4X rom=%4.4X: cams=%d transactions=%u errors=%u | ack p50/p90/p99=%ld/%ld/%ld | done p50/p90/p99=%ld/%ld/%ld [ms]\n",
+               all.vendor,all.model,all.rom,cams,all.transactions,all.errors,
+               histPercentile(&all.ack,50),histPercentile(&all.ack,90),histPercentile(&all.ack,99),
+               histPercentile(&all.done,50),histPercentile(&all.done,90),histPercentile(&all.done,99));
+    }
+    for ( i=0; i<RPL_Address; i++ )
+    {
+        if ( total.cmd[i].cnt == 0 )
+            continue;
+        printf("~~~~~~~~~~~~~~~~~~~ %-22s cnt=%u errors=%u | done p50/p90/p99=%ld/%ld/%ld [ms]\n",
+               SequenceNames[i],total.cmd[i].cnt,total.cmd[i].errors,
+               histPercentile(&total.cmd[i].done,50),histPercentile(&total.cmd[i].done,90),histPercentile(&total.cmd[i].done,99));
+    }
+    querySlo(now,range);
+}
+
+/* Return true if the sequence id is a inquiry command.
+ */
+static bool isInquiry ( int cmd )
+{
+    return cmd>0 && cmd<RPL_Address && sequences[cmd-1].seq[0]==0x09;
+}
+
+/* Difference of two timestamps in [ms].
+ */
+static long int timeDiff ( const struct timeval *from, const struct timeval *to )
+{
+    return (long int)(to->tv_sec-from->tv_sec)*1000L+(long int)(to->tv_usec-from->tv_usec)/1000L;
+}
+
+/* The same in [us].
+ */
+static long int timeDiffUs ( const struct timeval *from, const struct timeval *to )
+{
+    return (long int)(to->tv_sec-from->tv_sec)*1000000L+(long int)(to->tv_usec-from->tv_usec);
+}
+
+/* The current time, from the TSC if it's suitable (see initTsc()). The
+ * anchor is read with the seqlock, calibrateTsc() only holds it for a few
+ * stores. A TSC read before the anchor (another core) counts as the anchor.
+ */
+static void getTime ( struct timeval *tick )
+{
+    uint64_t anchor, mult, now;
+    int64_t real, ns;
+    unsigned seq;
+    bool valid;
+
+    for ( ;; )
+    {
+        seq = atomic_load_explicit(&Tsc.seq,memory_order_acquire);
+        valid = Tsc.valid;
+        anchor = Tsc.tsc;
+        mult = Tsc.mult;
+        real = Tsc.real;
+        atomic_thread_fence(memory_order_acquire);
+        if ( !(seq & 1) && atomic_load_explicit(&Tsc.seq,memory_order_relaxed) == seq )
+            break;
+    }
+    if ( !valid )
+    {
+        gettimeofday(tick,NULL);
+        return;
+    }
+    now = readTsc();
+    ns = real + ((now > anchor) ? scaleTsc(now-anchor,mult) : 0);
+    tick->tv_sec = (time_t)(ns / 1000000000LL);
+    tick->tv_usec = (suseconds_t)(ns % 1000000000LL / 1000LL);
+}
+
+/* Scale TSC ticks to [ns]. The ticks are scaled in fixed point, like the
+ * kernel does, so a timestamp costs little more than reading the TSC. The
+ * product is built from 32bit halves, so no 128bit type is needed on 32bit
+ * targets.
+ */
+static int64_t scaleTsc ( uint64_t ticks, uint64_t mult )
+{
+    uint64_t dh, dl, mh, ml;
+
+    dh = ticks >> 32;
+    dl = ticks & 0xFFFFFFFFULL;
+    mh = mult >> 32;
+    ml = mult & 0xFFFFFFFFULL;
+    return (int64_t)(((dh*mh) << 32) + dh*ml + dl*mh + ((dl*ml) >> 32));
+}
+
+/* Check if the TSC can be used as clock: it must be invariant (constant
+ * rate in all power states, CPUID 0x80000007 EDX bit 8), and two calibration
+ * windows must measure the same rate. Otherwise gettimeofday() is used.
+ */
+static bool initTsc ( void )
+{
+#ifdef HAVE_TSC
+    struct timespec pause = { 0, TSC_CALIBRATION*1000000L };
+    unsigned int a, b, c, d;
+    uint64_t tsc[3];
+    int64_t mono[3], real[3];
+    double rate[2];
+    int i;
+
+    memset(&Tsc,0,sizeof(Tsc));
+    if ( !__get_cpuid(0x80000007,&a,&b,&c,&d) || !(d & (1u << 8)) )
+    {
+        fputs("INFO: no invariant TSC, the timestamps are taken by gettimeofday().\n",stderr);
+        return false;
+    }
+    for ( i=0; i<3; i++ )
+    {
+        if ( i > 0 )
+            nanosleep(&pause,NULL);
+        if ( !readTscPair(&tsc[i],&mono[i],&real[i]) )
+            return false;
+    }
+    for ( i=0; i<2; i++ )
+    {
+        if ( tsc[i+1] <= tsc[i] )
+            return false;
+        rate[i] = (double)(mono[i+1]-mono[i]) / (double)(tsc[i+1]-tsc[i]);
+    }
+    if ( fabs(rate[1]/rate[0]-1.0) > TSC_MAX_DEVIATION*1e-6 )
+    {
+        fprintf(stderr,"INFO: the TSC is unsuitable (%.0f ppm), the timestamps are taken by gettimeofday().\n",
+                fabs(rate[1]/rate[0]-1.0)*1e6);
+        return false;
+    }
+    Tsc.ns_per_tick = (double)(mono[2]-mono[0]) / (double)(tsc[2]-tsc[0]);
+    Tsc.mult = (uint64_t)(Tsc.ns_per_tick * 4294967296.0);
+    Tsc.tsc = tsc[2];
+    Tsc.mono = mono[2];
+    Tsc.real = real[2];
+    Tsc.next = (time_t)(real[2]/1000000000LL) + TSC_RECALIBRATE;
+    Tsc.valid = true;
+    fprintf(stderr,"INFO: the timestamps are taken by the TSC (%.3f GHz).\n",1.0/Tsc.ns_per_tick);
+    return true;
+#else
+    fputs("INFO: no TSC, the timestamps are taken by gettimeofday().\n",stderr);
+    return false;
+#endif
+}
+
+/* Recalibrate the TSC each TSC_RECALIBRATE seconds. The rate is measured
+ * over the time since the last calibration, and the error of the time
+ * predicted by the old rate is kept as drift. If the rate changed too much
+ * (e.g. a VM was migrated), gettimeofday() is used from now on.
+ *
+ * The new anchor is the time the clock shows, not CLOCK_REALTIME. The offset
+ * is slewed over the next TSC_RECALIBRATE seconds, by TSC_MAX_SLEW at most.
+ * A larger offset ahead (the system time was set forward) is stepped, one
+ * behind is slewed over the following calibrations, so the time never goes
+ * back.
+ */
+static void calibrateTsc ( const struct timeval *now )
+{
+    const int64_t limit = (int64_t)TSC_MAX_SLEW*1000LL*TSC_RECALIBRATE;      // [ns]
+    uint64_t tsc;
+    int64_t mono, real, drift, shown, offset;
+    double rate;
+    unsigned seq;
+
+    if ( !Tsc.valid || now->tv_sec < Tsc.next || !readTscPair(&tsc,&mono,&real) )
+        return;
+    Tsc.next = now->tv_sec + TSC_RECALIBRATE;
+    rate = (tsc > Tsc.tsc) ? (double)(mono-Tsc.mono) / (double)(tsc-Tsc.tsc) : 0.0;
+    if ( fabs(rate/Tsc.ns_per_tick-1.0) > TSC_MAX_DEVIATION*1e-6 )
+    {
+        fprintf(stderr,"warning: the rate of the TSC changed by %.0f ppm, the timestamps are taken by gettimeofday().\n",
+                fabs(rate/Tsc.ns_per_tick-1.0)*1e6);
+        seq = atomic_load_explicit(&Tsc.seq,memory_order_relaxed);
+        atomic_store_explicit(&Tsc.seq,seq+1,memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        Tsc.valid = false;
+        atomic_store_explicit(&Tsc.seq,seq+2,memory_order_release);
+        return;
+    }
+    drift = Tsc.mono + (int64_t)((double)(tsc-Tsc.tsc) * Tsc.ns_per_tick) - mono;
+    if ( llabs(drift) > Tsc.drift )
+        Tsc.drift = llabs(drift);
+    shown = Tsc.real + scaleTsc(tsc-Tsc.tsc,Tsc.mult);
+    offset = real - shown;
+    if ( llabs(offset) > Tsc.offset )
+        Tsc.offset = llabs(offset);
+    if ( offset > limit )
+    {
+        shown += offset - limit;
+        offset = limit;
+    }
+    else if ( offset < -limit )
+        offset = -limit;
+
+    seq = atomic_load_explicit(&Tsc.seq,memory_order_relaxed);
+    atomic_store_explicit(&Tsc.seq,seq+1,memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    Tsc.ns_per_tick = rate;
+    Tsc.mult = (uint64_t)(rate * (1.0 + (double)offset/(TSC_RECALIBRATE*1e9)) * 4294967296.0);
+    Tsc.tsc = tsc;
+    Tsc.mono = mono;
+    Tsc.real = shown;
+    atomic_store_explicit(&Tsc.seq,seq+2,memory_order_release);
+    Tsc.calibrations++;
+}
+
+/* Read the TSC together with CLOCK_MONOTONIC and CLOCK_REALTIME. The read
+ * with the least TSC ticks around the clocks is used, the TSC is taken as
+ * the middle.
+ */
+static bool readTscPair ( uint64_t *tsc, int64_t *mono, int64_t *real )
+{
+    struct timespec m, r;
+    uint64_t t0, t1, best = UINT64_MAX;
+    int i;
+
+    for ( i=0; i<TSC_PAIR_TRIES; i++ )
+    {
+        t0 = readTsc();
+        clock_gettime(CLOCK_MONOTONIC,&m);
+        clock_gettime(CLOCK_REALTIME,&r);
+        t1 = readTsc();
+        if ( t1 < t0 || t1-t0 >= best )
+            continue;
+        best = t1-t0;
+        *tsc = t0 + (t1-t0)/2;
+        *mono = (int64_t)m.tv_sec*1000000000LL + m.tv_nsec;
+        *real = (int64_t)r.tv_sec*1000000000LL + r.tv_nsec;
+    }
+    return best != UINT64_MAX;
+}
+
+static uint64_t readTsc ( void )
+{
+#ifdef HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/* Build the packed keys of the sequences used by findCommands().
+ */
+static void prepareSequences ( void )
+{
+    int i, j;
+
+    for ( i=0; i<CMD_MAX_SEQUENCES; i++ )
+    {
+        SequenceKey[i] = SequenceMask[i] = 0;
+        for ( j=0; j<sequences[i].comparable && j<4; j++ )
+        {
+            SequenceKey[i] |= (uint32_t)sequences[i].seq[j] << (8*j);
+            SequenceMask[i] |= (uint32_t)0xFF << (8*j);
+        }
+        SequenceLength[i] = sequences[i].length+2;
+    }
+    SequencesPrepared = true;
+}
+
+/* Return the camera address of a packet header. Replies have the camera as
+ * source, commands as destination. A broadcast returns VISCA_BROADCAST.
+ */
+static int decodeAddress ( uint8_t header )
+{
+    int address;
+
+    if ( (header & 0x0F) == VISCA_BROADCAST )
+        return VISCA_BROADCAST;
+    address = (header >> 4) & 0x07;
+    if ( address == 0 )
+        address = header & 0x07;
+    return address;
+}
+
+/* Return the parameter bytes of a known sequence (without the terminator) as
+ * big endian value. Four byte parameters are nibbles (like the position of
+ * ZoomDirect), so they are combined to a 16bit value.
+ */
+static uint32_t decodeParameter ( const uint8_t *frame, uint8_t len, int cmd )
+{
+    uint32_t param = 0;
+    int i, from, cnt;
+
+    if ( cmd <= 0 )
+        return 0;
+    from = sequences[cmd-1].comparable+1;
+    cnt = len-1-from;
+    if ( cnt == 4 )
+    {
+        for ( i=from; i<len-1; i++ )
+            param = (param << 4) | (frame[i] & 0x0F);
+    }
+    else
+    {
+        for ( i=from; i<len-1 && i<from+4; i++ )
+            param = (param << 8) | frame[i];
+    }
+    return param;
+}
+
+/* Classify `n` packets at once. The packets are stored in `data` (with `size`
+ * bytes) at `offset[i]` with `length[i]` bytes. The results are written to the
+ * arrays `cmd` (sequence id like findCommand), `address`, `socket` and
+ * `param` (see decodeParameter). Packets shorter than VISCA_MIN_SIZE get the
+ * id -1.
+ *
+ * The packets are processed in blocks. The bytes 1..4 of each packet are
+ * gathered into an array of keys first. Than each sequence is compared with
+ * all keys of the block. This inner loop has no branches, so the compiler can
+ * use SIMD instructions. The sequences are compared in reverse order, so the
+ * first matching sequence wins like in findCommand().
+ */
+static void findCommands ( const uint8_t *data, size_t size, const uint32_t *offset, const uint8_t *length, int n,
+                           int16_t *cmd, uint8_t *address, uint8_t *socket, uint32_t *param )
+{
+    uint32_t key[BATCH_BLOCK];          // all 32bit, so the compare loop
+    uint32_t len[BATCH_BLOCK];          // uses a single vector width
+    uint32_t id[BATCH_BLOCK];
+    uint8_t tmp[4];
+    const uint8_t *frame;
+    int base, cnt, i, j;
+
+    if ( !SequencesPrepared )
+        prepareSequences();
+    for ( base=0; base<n; base+=BATCH_BLOCK )
+    {
+        cnt = (n-base < BATCH_BLOCK) ? n-base : BATCH_BLOCK;
+
+        // gather the keys (the tail of the data is copied), a short record
+        // (e.g. a timeout) has none
+        for ( j=0; j<cnt; j++ )
+        {
+            frame = data + offset[base+j];
+            if ( length[base+j] < VISCA_MIN_SIZE || offset[base+j] >= size )
+            {
+                key[j] = len[j] = 0;
+                continue;
+            }
+            if ( offset[base+j]+5 <= size )
+                memcpy(&key[j],frame+1,4);
+            else
+            {
+                memset(tmp,0,sizeof(tmp));
+                memcpy(tmp,frame+1,size-offset[base+j]-1);
+                memcpy(&key[j],tmp,4);
+            }
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            key[j] = __builtin_bswap32(key[j]);
+#endif
+            len[j] = length[base+j];
+        }
+        for ( ; j<BATCH_BLOCK; j++ )
+            key[j] = len[j] = 0;
+        memset(id,0,sizeof(id));
+
+        // compare the keys (the last entry of `sequences` is empty)
+        for ( i=CMD_MAX_SEQUENCES-2; i>=0; i-- )
+        {
+            const uint32_t k = SequenceKey[i];
+            const uint32_t m = SequenceMask[i];
+            const uint32_t l = SequenceLength[i];
+
+            for ( j=0; j<BATCH_BLOCK; j++ )    // the whole block, without a tail
+                id[j] = ((key[j] & m) == k && len[j] == l) ? (uint32_t)(i+1) : id[j];
+        }
+
+        // decode the rest
+        for ( j=0; j<cnt; j++ )
+        {
+            frame = data + offset[base+j];
+            if ( len[j] < VISCA_MIN_SIZE )
+            {
+                cmd[base+j] = -1;
+                address[base+j] = socket[base+j] = 0;
+                param[base+j] = 0;
+                continue;
+            }
+            cmd[base+j] = (int16_t)id[j];
+            address[base+j] = (uint8_t)decodeAddress(frame[0]);
+            socket[base+j] = ((frame[0] & 0x70) && (frame[1] & 0xF0) >= VISCA_TYPE_RESPONSE_ACK)
+                             ? (frame[1] & 0x0F) : 0;
+            param[base+j] = decodeParameter(frame,(uint8_t)len[j],(int)id[j]);
+        }
+    }
+}
+
+/* Open a capture file. In the "direct" mode, the file is written with
+ * O_DIRECT by a background thread. If the file system doesn't support
+ * O_DIRECT, the page cache is used.
+ */
+static T_Capture *openCapture ( const char *FileName, bool direct )
+{
+    T_Capture *cap;
+    T_CaptureHeader hdr;
+    int i, n = direct ? CAPTURE_RING : 2;
+
+    cap = calloc(1,sizeof(T_Capture));
+    if ( !cap )
+        return NULL;
+    cap->direct = direct;
+    cap->fd = -1;
+    for ( i=0; i<n; i++ )
+    {
+        if ( posix_memalign((void **)&cap->buffer[i],CAPTURE_ALIGN,CAPTURE_BLOCK) != 0 )
+        {
+            fputs("ERROR: openCapture(): out of memory\n",stderr);
+            cap->buffer[i] = NULL;
+            freeCapture(cap);
+            return NULL;
+        }
+        memset(cap->buffer[i],0,CAPTURE_BLOCK);     // no page faults later
+    }
+    cap->fd = open(FileName,O_WRONLY|O_CREAT|O_TRUNC|(direct ? O_DIRECT : 0),0644);
+    if ( cap->fd < 0 && direct && errno == EINVAL )
+    {
+        fprintf(stderr,"warning: O_DIRECT not supported for `%s'\n",FileName);
+        cap->fd = open(FileName,O_WRONLY|O_CREAT|O_TRUNC,0644);
+    }
+    if ( cap->fd < 0 )
+    {
+        fprintf(stderr,"ERROR: can't create capture file `%s'!\n",FileName);
+        freeCapture(cap);
+        return NULL;
+    }
+
+    memset(&hdr,0,sizeof(hdr));
+    strcpy(hdr.magic,CAPTURE_MAGIC);
+    hdr.block_size = CAPTURE_BLOCK;
+    memcpy(cap->buffer[0],&hdr,sizeof(hdr));
+    cap->fill = sizeof(hdr);
+
+    if ( direct )
+    {
+        pthread_mutex_init(&cap->lock,NULL);
+        pthread_cond_init(&cap->cond,NULL);
+        if ( pthread_create(&cap->thread,NULL,captureWriter,cap) != 0 )
+        {
+            fputs("ERROR: openCapture(): can't start the writer\n",stderr);
+            pthread_mutex_destroy(&cap->lock);
+            pthread_cond_destroy(&cap->cond);
+            freeCapture(cap);
+            return NULL;
+        }
+    }
+    fprintf(stderr,"INFO: capture to `%s'%s\n",FileName,direct?" (direct)":"");
+    return cap;
+}
+
+/* Release the buffers and the file of a capture.
+ */
+static void freeCapture ( T_Capture *cap )
+{
+    int i;
+
+    if ( cap->fd >= 0 )
+        close(cap->fd);
+    for ( i=0; i<CAPTURE_RING; i++ )
+        free(cap->buffer[i]);
+    free(cap);
+}
+
+/* Append a record to the capture file. This is called by the capture thread.
+ * In the direct mode, the usual worst case is a copy of the record and a hand
+ * over of the full buffer to the writer (a mutex without contention and a
+ * signal). Only with the ring full, it waits up to CAPTURE_WAIT ms.
+ */
+static void writeCapture ( T_Capture *cap, int line, uint8_t status, const struct timeval *tick, const uint8_t *data, int num,
+                           uint8_t flags )
+{
+    T_CaptureRecord rec;
+    uint64_t usec;
+    size_t size;
+
+    if ( !cap || num <= 0 )
+        return;
+    size = sizeof(rec)+num;
+    if ( cap->fill+size > CAPTURE_BLOCK )
+    {
+        flushCapture(cap);
+        if ( cap->fill+size > CAPTURE_BLOCK )
+        {
+            cap->dropped++;                     // the writer is stuck
+            return;
+        }
+    }
+    rec.line = (uint8_t)(line+1);
+    rec.num = (uint8_t)num;
+    rec.status = status;
+    rec.flags = flags;
+    usec = (uint64_t)tick->tv_sec*1000000ULL + (uint64_t)tick->tv_usec;
+    memcpy(rec.usec,&usec,sizeof(usec));
+    memcpy(cap->buffer[cap->active]+cap->fill,&rec,sizeof(rec));
+    memcpy(cap->buffer[cap->active]+cap->fill+sizeof(rec),data,num);
+    cap->fill += size;
+}
+
+/* The active buffer is full (or the capture is closed). The rest of the block
+ * is padded. Without the direct mode, the block is written here. Otherwise
+ * the buffer is handed over to the writer and the next buffer of the ring is
+ * filled. If the ring is full, this waits up to CAPTURE_WAIT ms.
+ */
+static void flushCapture ( T_Capture *cap )
+{
+    struct timespec timeout;
+
+    if ( cap->fill < CAPTURE_BLOCK )
+        memset(cap->buffer[cap->active]+cap->fill,0,CAPTURE_BLOCK-cap->fill);
+    if ( !cap->direct )
+    {
+        if ( write(cap->fd,cap->buffer[cap->active],CAPTURE_BLOCK) != CAPTURE_BLOCK )
+            fputs("ERROR: flushCapture(): write failed\n",stderr);
+        cap->offset += CAPTURE_BLOCK;
+        cap->blocks++;
+        cap->fill = 0;
+        return;
+    }
+    pthread_mutex_lock(&cap->lock);
+    if ( cap->full >= CAPTURE_RING-1 )
+    {
+        cap->waits++;
+        clock_gettime(CLOCK_REALTIME,&timeout);
+        timeout.tv_nsec += CAPTURE_WAIT*1000000L;
+        if ( timeout.tv_nsec >= 1000000000L )
+        {
+            timeout.tv_sec++;
+            timeout.tv_nsec -= 1000000000L;
+        }
+        while ( cap->full >= CAPTURE_RING-1 )
+            if ( pthread_cond_timedwait(&cap->cond,&cap->lock,&timeout) == ETIMEDOUT )
+                break;
+    }
+    if ( cap->full < CAPTURE_RING-1 )
+    {
+        cap->full++;
+        cap->active = (cap->active+1)%CAPTURE_RING;
+        cap->fill = 0;
+        pthread_cond_signal(&cap->cond);
+    }
+    else
+        cap->fill = CAPTURE_BLOCK;              // keep it, retry later
+    pthread_mutex_unlock(&cap->lock);
+}
+
+/* The background writer of the direct mode. The full buffers of the ring
+ * are written as blocks in order. The file is preallocated in steps of
+ * CAPTURE_PREALLOC. All CAPTURE_SYNC seconds the data is synced, the longest
+ * fdatasync() is kept to check the size of the ring.
+ */
+static void *captureWriter ( void *arg )
+{
+    T_Capture *cap = (T_Capture *)arg;
+    struct timespec timeout, synced, now;
+    bool dirty = false;
+    long stall;
+    int idx;
+
+    clock_gettime(CLOCK_MONOTONIC,&synced);
+    pthread_mutex_lock(&cap->lock);
+    for ( ;; )
+    {
+        if ( cap->full == 0 )
+        {
+            if ( cap->stop )
+                break;
+            clock_gettime(CLOCK_REALTIME,&timeout);
+            timeout.tv_sec += CAPTURE_SYNC;
+            pthread_cond_timedwait(&cap->cond,&cap->lock,&timeout);
+        }
+        idx = cap->full > 0 ? cap->head : -1;
+        pthread_mutex_unlock(&cap->lock);
+
+        if ( idx >= 0 )
+        {
+            if ( cap->offset+CAPTURE_BLOCK > cap->allocated && cap->allocated != UINT64_MAX )
+            {
+                if ( fallocate(cap->fd,0,(off_t)cap->allocated,CAPTURE_PREALLOC) == 0 )
+                    cap->allocated += CAPTURE_PREALLOC;
+                else
+                    cap->allocated = UINT64_MAX;    // not supported, don't try again
+            }
+            if ( pwrite(cap->fd,cap->buffer[idx],CAPTURE_BLOCK,(off_t)cap->offset) != CAPTURE_BLOCK )
+                cap->failed = true;
+            cap->offset += CAPTURE_BLOCK;
+            cap->blocks++;
+            dirty = true;
+        }
+        clock_gettime(CLOCK_MONOTONIC,&now);
+        if ( dirty && now.tv_sec-synced.tv_sec >= CAPTURE_SYNC )
+        {
+            fdatasync(cap->fd);
+            clock_gettime(CLOCK_MONOTONIC,&synced);
+            stall = (synced.tv_sec-now.tv_sec)*1000000L + (synced.tv_nsec-now.tv_nsec)/1000;
+            if ( stall > cap->stall )
+                cap->stall = stall;
+            dirty = false;
+        }
+
+        pthread_mutex_lock(&cap->lock);
+        if ( idx >= 0 )
+        {
+            cap->head = (cap->head+1)%CAPTURE_RING;
+            cap->full--;
+            pthread_cond_broadcast(&cap->cond);
+        }
+    }
+    pthread_mutex_unlock(&cap->lock);
+    return NULL;
+}
+
+/* Write the last block and close the capture file. The preallocated space
+ * behind the last block is released.
+ */
+static void closeCapture ( T_Capture *cap )
+{
+    if ( !cap )
+        return;
+    if ( cap->direct )
+    {
+        pthread_mutex_lock(&cap->lock);
+        while ( cap->full >= CAPTURE_RING-1 )   // the last block isn't dropped
+            pthread_cond_wait(&cap->cond,&cap->lock);
+        pthread_mutex_unlock(&cap->lock);
+        if ( cap->fill > 0 )
+            flushCapture(cap);
+        pthread_mutex_lock(&cap->lock);
+        cap->stop = true;
+        pthread_cond_signal(&cap->cond);
+        pthread_mutex_unlock(&cap->lock);
+        pthread_join(cap->thread,NULL);
+        pthread_mutex_destroy(&cap->lock);
+        pthread_cond_destroy(&cap->cond);
+    }
+    else if ( cap->fill > 0 )
+        flushCapture(cap);
+    if ( ftruncate(cap->fd,(off_t)cap->offset) < 0 )
+        fputs("warning: closeCapture(): truncate failed\n",stderr);
+    fdatasync(cap->fd);
+    if ( cap->failed )
+        fputs("ERROR: closeCapture(): write failed\n",stderr);
+    fprintf(stderr,"INFO: capture closed, %ld blocks, %ld records dropped",(long)cap->blocks,cap->dropped);
+    if ( cap->direct )
+        fprintf(stderr,", %ld waits for the writer, longest fdatasync() %ld us",cap->waits,(long)cap->stall);
+    fputc('\n',stderr);
+    freeCapture(cap);
+}
+
+/* Replay a capture file. Each record is processed like a received packet.
+ */
+static bool replayCapture ( const char *FileName )
+{
+    T_CaptureHeader hdr;
+    uint8_t *block;
+    size_t pos;
+    bool ok = true;
+    FILE *f;
+
+    f = fopen(FileName,"rb");
+    if ( !f )
+    {
+        fprintf(stderr,"ERROR: can't open capture file `%s'!\n",FileName);
+        return false;
+    }
+    block = malloc(CAPTURE_BLOCK);
+    if ( !block )
+    {
+        fclose(f);
+        return false;
+    }
+    pos = sizeof(hdr);
+    while ( fread(block,CAPTURE_BLOCK,1,f) == 1 )
+    {
+        if ( pos == sizeof(hdr) )
+        {
+            memcpy(&hdr,block,sizeof(hdr));
+            if ( strcmp(hdr.magic,CAPTURE_MAGIC)!=0 || hdr.block_size!=CAPTURE_BLOCK )
+            {
+                fprintf(stderr,"ERROR: `%s' is no capture file!\n",FileName);
+                ok = false;
+                break;
+            }
+        }
+        if ( !replayBlock(block,pos,false) )
+            ok = false;         // the next blocks are still replayed
+        pos = 0;
+    }
+    free(block);
+    fclose(f);
+    return ok;
+}
+
+/* Process the records of a capture block, starting at `pos`. With `quiet`,
+ * nothing is dumped. Returns false for a bad record; the rest of the block is
+ * skipped.
+ */
+static bool replayBlock ( const uint8_t *block, size_t pos, bool quiet )
+{
+    T_CaptureRecord rec;
+    T_VISCAInterface *intf;
+    uint64_t usec;
+    uint8_t rc;
+    bool ok = true;
+
+    Quiet = quiet;
+    while ( pos+sizeof(rec) <= CAPTURE_BLOCK )
+    {
+        memcpy(&rec,block+pos,sizeof(rec));
+        if ( rec.line == CAPTURE_PAD )
+            break;
+        if ( rec.num > VISCA_MAX_SIZE || pos+sizeof(rec)+rec.num > CAPTURE_BLOCK )
+        {
+            fputs("ERROR: replayCapture(): bad record\n",stderr);
+            ok = false;
+            break;
+        }
+        intf = (rec.line == LINE_CTL+1) ? &sender : &receiver;
+        if ( rec.flags & CAPTURE_INJECTED )
+            intf = &injected;           // dumped with the packet answered
+        memcpy(intf->buffer,block+pos+sizeof(rec),rec.num);
+        intf->num = rec.num;
+        memcpy(&usec,rec.usec,sizeof(usec));
+        intf->received.tv_sec = (time_t)(usec/1000000ULL);
+        intf->received.tv_usec = (suseconds_t)(usec%1000000ULL);
+        if ( rec.status == VISCA_SUCCESS )
+            rc = decodePacket(intf);
+        else
+        {
+            intf->valid = false;
+            rc = rec.status;
+        }
+        pos += sizeof(rec)+rec.num;
+        if ( (rec.flags & CAPTURE_OWN) && rec.line == LINE_CTL+1 )
+            dumpViscaPacket(&injected,0L);      // an inquiry of the proxy
+        else if ( (rec.flags & CAPTURE_OWN) && rc == VISCA_SUCCESS )
+        {
+            checkInterval(&intf->received);     // its reply is on the line, no transaction
+            countPacket(intf,rc);
+            if ( injected.cmd == RPL_Version )
+                decodeVersion(&injected,true);
+        }
+        if ( intf == &injected )
+            continue;
+        intf->cached = (rec.flags & CAPTURE_PROXY) != 0;
+        checkInterval(&intf->received);
+        processPacket(intf,rc);
+    }
+    Quiet = false;
+    return ok;
+}
+
+/* Replay a capture into the store, using the cached analysis of unchanged
+ * blocks. The intervals finished within a block and the interval still open
+ * at its end are kept as partials of the block. They are written to the
+ * cache, and merged in time order into the store, so the store gets the same
+ * intervals as by replayCapture(). A block is only analysed if it is new or
+ * it (or the block before) changed. The block before is replayed first
+ * without output, so open transactions aren't lost. Only the packets of the
+ * analysed blocks are dumped. The new cache replaces the old one at the end.
+ *
+ * The cache records the store the blocks were merged into. Into the same
+ * store, only the blocks after the merged ones are merged, the intervals of
+ * other captures or of a live run stay. A merged block can't be taken back:
+ * if it changed, the store must be recreated. The interval open at the end
+ * is written with the time up to the last packet. The next replay takes
+ * this time back and merges the rest of the interval.
+ */
+static bool replayCached ( const char *FileName )
+{
+    char name[FILENAME_MAX+8], tmp[FILENAME_MAX+16], config[128];
+    T_PartialsHeader hdr, old;
+    T_PartialsEntry entry;
+    T_CaptureHeader cap;
+    T_Interval last;
+    uint8_t *block, *before;
+    uint64_t hash, prev = 0;
+    int64_t start, first, end;
+    uint32_t k, i, hits = 0, warm = 0, merged = 0;
+    bool ok = true, bad = false, cached, skipped = false, written = false;
+    FILE *f, *in, *out;
+
+    memset(&old,0,sizeof(old));
+    snprintf(name,sizeof(name),"%s%s",FileName,PARTIALS_SUFFIX);
+    snprintf(tmp,sizeof(tmp),"%s.tmp",name);
+    snprintf(config,sizeof(config),"%d/%s/%d/%zu/%d",ANALYSIS_VERSION,RRD_MAGIC,INTERVAL_LENGTH,
+             sizeof(T_Interval),CMD_MAX_SEQUENCES);
+    memset(&hdr,0,sizeof(hdr));
+    strcpy(hdr.magic,PARTIALS_MAGIC);
+    hdr.config = hashFNV(FNV_OFFSET,config,strlen(config));
+    hdr.block_size = CAPTURE_BLOCK;
+    hdr.store = ((const T_RrdHeader *)Rrd)->id;
+
+    f = fopen(FileName,"rb");
+    if ( !f )
+    {
+        fprintf(stderr,"ERROR: can't open capture file `%s'!\n",FileName);
+        return false;
+    }
+    in = fopen(name,"rb");
+    if ( in && (fread(&old,sizeof(old),1,in) != 1 || strcmp(old.magic,PARTIALS_MAGIC) != 0) )
+    {
+        fprintf(stderr,"INFO: cache `%s' is outdated.\n",name);
+        fclose(in);
+        in = NULL;
+    }
+    if ( in && old.store == hdr.store )
+        merged = old.merged;
+    if ( in && (old.config != hdr.config || old.block_size != CAPTURE_BLOCK) )
+    {
+        fclose(in);
+        in = NULL;
+        if ( merged > 0 )
+        {
+            fprintf(stderr,"ERROR: store `%s' holds %u blocks of an older analysis, use a new store!\n",
+                    RrdFileName,merged);
+            fclose(f);
+            return false;
+        }
+        fprintf(stderr,"INFO: cache `%s' is outdated.\n",name);
+    }
+    out = fopen(tmp,"wb");
+    block = malloc(CAPTURE_BLOCK);
+    before = malloc(CAPTURE_BLOCK);
+    if ( !out || !block || !before || !reserveWords(2*PARTIAL_WORDS+1) || fwrite(&hdr,sizeof(hdr),1,out) != 1 )
+    {
+        fprintf(stderr,"ERROR: can't write cache `%s'!\n",tmp);
+        ok = false;
+    }
+    memset(&Merged,0,sizeof(Merged));
+    Partials = malloc(8*sizeof(T_Interval));    // the partials are collected from now on
+    PartialsMax = 8;
+
+    for ( k=0; ok && Partials && fread(block,CAPTURE_BLOCK,1,f) == 1; k++ )
+    {
+        if ( k == 0 )
+        {
+            memcpy(&cap,block,sizeof(cap));
+            if ( strcmp(cap.magic,CAPTURE_MAGIC)!=0 || cap.block_size!=CAPTURE_BLOCK )
+            {
+                fprintf(stderr,"ERROR: `%s' is no capture file!\n",FileName);
+                ok = false;
+                break;
+            }
+        }
+        hash = hashFNV(FNV_OFFSET,block,CAPTURE_BLOCK);
+        PartialsCount = 0;
+
+        // the cached entry of the block (the entries are read in order)
+        cached = false;
+        if ( in && k < old.blocks && fread(&entry,sizeof(entry),1,in) == 1 )
+        {
+            if ( entry.hash == hash && entry.prev == prev )
+            {
+                cached = readPartials(in,&entry);
+                if ( !cached )
+                {
+                    fclose(in);         // broken, analyse the rest
+                    in = NULL;
+                }
+            }
+            else
+                fseek(in,(long)(entry.words*sizeof(uint32_t)),SEEK_CUR);
+        }
+        if ( k < merged && !cached )
+        {
+            // nothing was written to the store yet, the merged blocks come first
+            fprintf(stderr,"ERROR: block %u of `%s' changed after it was merged into the store `%s', use a new store!\n",
+                    k,FileName,RrdFileName);
+            ok = false;
+            break;
+        }
+        if ( cached )
+        {
+            for ( i=1; i<=VISCA_MAX_CAMERAS; i++ )
+            {
+                cameras[i].vendor = entry.model[i][0];
+                cameras[i].model = entry.model[i][1];
+                cameras[i].rom = entry.model[i][2];
+            }
+            hits++;
+            skipped = true;
+        }
+        else
+        {
+            // warm up with the block before, without output and partials
+            if ( skipped )
+            {
+                replayBlock(before,k==1 ? sizeof(cap) : 0,true);
+                PartialsCount = 0;
+                warm++;
+                skipped = false;
+            }
+
+            // the counters of the open interval are a partial of the block before
+            start = Interval.start;
+            memset(&Interval,0,sizeof(Interval));
+            Interval.start = start;
+            if ( !replayBlock(block,k==0 ? sizeof(cap) : 0,false) )
+                bad = true;
+            if ( Interval.start != 0 )
+            {
+                last = Interval;
+                for ( i=1; i<=VISCA_MAX_CAMERAS; i++ )
+                {
+                    last.cam[i].vendor = cameras[i].vendor;
+                    last.cam[i].model = cameras[i].model;
+                    last.cam[i].rom = cameras[i].rom;
+                }
+                addPartial(&last);
+            }
+            memset(&entry,0,sizeof(entry));
+            entry.hash = hash;
+            entry.prev = prev;
+            for ( i=1; i<=VISCA_MAX_CAMERAS; i++ )
+            {
+                entry.model[i][0] = cameras[i].vendor;
+                entry.model[i][1] = cameras[i].model;
+                entry.model[i][2] = cameras[i].rom;
+            }
+            if ( !packPartials(&entry) )
+                ok = false;
+        }
+
+        if ( fwrite(&entry,sizeof(entry),1,out) != 1
+             || fwrite(Packed,sizeof(uint32_t),entry.words,out) != entry.words )
+        {
+            fprintf(stderr,"ERROR: can't write cache `%s'!\n",tmp);
+            ok = false;
+        }
+        if ( k >= merged )
+        {
+            // the open interval of the last replay is continued
+            if ( !written && merged > 0 && old.open_start != 0 )
+                retractStore(old.open_start,old.open_duration);
+            written = true;
+            for ( i=0; i<PartialsCount; i++ )
+                mergePartial(&Partials[i]);
+        }
+        memcpy(before,block,CAPTURE_BLOCK);
+        prev = hash;
+    }
+    // the last interval is still open, it covers the time up to the last packet
+    hdr.blocks = hdr.merged = k;
+    if ( !written && merged > 0 )
+    {
+        hdr.open_start = old.open_start;        // no new block
+        hdr.open_duration = old.open_duration;
+    }
+    if ( ok && Merged.start != 0 && k > 0 && reportTimes(before,k==1 ? sizeof(cap) : 0,&first,&end) )
+    {
+        Merged.duration = (uint32_t)((end/1000000 > Merged.start) ? end/1000000 - Merged.start : 0);
+        if ( Merged.duration > INTERVAL_LENGTH )
+            Merged.duration = INTERVAL_LENGTH;
+        Merged.intervals = 1;
+        writeStore(&Merged);
+        hdr.open_start = Merged.start;
+        hdr.open_duration = Merged.duration;
+    }
+
+    if ( out )
+    {
+        if ( ok && (fseek(out,0,SEEK_SET) != 0 || fwrite(&hdr,sizeof(hdr),1,out) != 1) )
+            ok = false;
+        if ( fclose(out) != 0 )
+            ok = false;
+        // a block with a bad record is merged like the others, it's reported once
+        if ( ok && rename(tmp,name) != 0 )
+            ok = false;
+        if ( !ok )
+            unlink(tmp);
+    }
+    if ( !ok && written )
+        fprintf(stderr,"ERROR: the store `%s' holds blocks not recorded in the cache, use a new store!\n",RrdFileName);
+    if ( ok )
+        fprintf(stderr,"INFO: %u blocks, %u from the cache `%s', %u analysed (%u warmed up), %u merged into the store\n",
+                k,hits,name,k-hits,warm,k-merged);
+    if ( in )
+        fclose(in);
+    fclose(f);
+    free(block);
+    free(before);
+    free(Partials);
+    free(Packed);
+    Partials = NULL;
+    Packed = NULL;
+    PartialsMax = PackedMax = 0;
+    return ok && !bad;
+}
+
+/* Read the packed partials of a cache entry into `Partials`.
+ */
+static bool readPartials ( FILE *in, const T_PartialsEntry *entry )
+{
+    T_Interval *p;
+    uint32_t pos = 0, used;
+
+    if ( !reserveWords(entry->words)
+         || fread(Packed,sizeof(uint32_t),entry->words,in) != entry->words )
+        return false;
+    while ( PartialsCount < entry->partials )
+    {
+        if ( (p = newPartial()) == NULL )
+            return false;
+        used = unpackInterval(Packed+pos,entry->words-pos,p);
+        if ( used == 0 )
+            return false;
+        pos += used;
+    }
+    return pos == entry->words;
+}
+
+/* Pack the partials of the current block into `Packed`.
+ */
+static bool packPartials ( T_PartialsEntry *entry )
+{
+    uint32_t i;
+
+    entry->partials = PartialsCount;
+    entry->words = 0;
+    for ( i=0; i<PartialsCount; i++ )
+    {
+        if ( !reserveWords(entry->words+2*PARTIAL_WORDS+1) )
+            return false;
+        entry->words += packInterval(&Partials[i],Packed+entry->words);
+    }
+    return true;
+}
+
+/* Pack an interval for the cache. Most counters of an interval are 0, so
+ * runs of zero words are skipped: each run starts with a word holding the
+ * number of zero words (high half) and of the words following (low half).
+ * Returns the number of words written (at most 2*PARTIAL_WORDS+1).
+ */
+static uint32_t packInterval ( const T_Interval *interval, uint32_t *out )
+{
+    const uint32_t *w = (const uint32_t *)interval;
+    uint32_t pos = 0, n = 0, zeros, literals;
+
+    while ( pos < PARTIAL_WORDS )
+    {
+        for ( zeros=0; pos+zeros < PARTIAL_WORDS && w[pos+zeros] == 0; zeros++ )
+            ;
+        pos += zeros;
+        for ( literals=0; pos+literals < PARTIAL_WORDS && w[pos+literals] != 0; literals++ )
+            ;
+        out[n++] = (zeros << 16) | literals;
+        memcpy(out+n,w+pos,literals*sizeof(uint32_t));
+        n += literals;
+        pos += literals;
+    }
+    return n;
+}
+
+/* Unpack an interval packed by packInterval(). Returns the number of words
+ * used, 0 if the data is broken.
+ */
+static uint32_t unpackInterval ( const uint32_t *in, uint32_t words, T_Interval *interval )
+{
+    uint32_t *w = (uint32_t *)interval;
+    uint32_t pos = 0, n = 0, zeros, literals;
+
+    while ( pos < PARTIAL_WORDS )
+    {
+        if ( n >= words )
+            return 0;
+        zeros = in[n] >> 16;
+        literals = in[n++] & 0xFFFF;
+        if ( pos+zeros+literals > PARTIAL_WORDS || n+literals > words )
+            return 0;
+        memset(w+pos,0,zeros*sizeof(uint32_t));
+        pos += zeros;
+        memcpy(w+pos,in+n,literals*sizeof(uint32_t));
+        pos += literals;
+        n += literals;
+    }
+    return n;
+}
+
+/* Make room for `words` packed words.
+ */
+static bool reserveWords ( uint32_t words )
+{
+    uint32_t *p;
+
+    if ( words <= PackedMax )
+        return true;
+    p = realloc(Packed,words*sizeof(uint32_t));
+    if ( !p )
+        return false;
+    Packed = p;
+    PackedMax = words;
+    return true;
+}
+
+/* Keep an interval as partial of the current block.
+ */
+static void addPartial ( const T_Interval *interval )
+{
+    T_Interval *p = newPartial();
+
+    if ( p )
+        *p = *interval;
+}
+
+/* Append a partial to the list of the current block.
+ */
+static T_Interval *newPartial ( void )
+{
+    T_Interval *p;
+
+    if ( PartialsCount == PartialsMax )
+    {
+        p = realloc(Partials,2*PartialsMax*sizeof(T_Interval));
+        if ( !p )
+            return NULL;
+        Partials = p;
+        PartialsMax *= 2;
+    }
+    return &Partials[PartialsCount++];
+}
+
+/* Merge the partials in time order. An interval is written to the store when
+ * the next one starts.
+ */
+static void mergePartial ( const T_Interval *interval )
+{
+    if ( Merged.start == interval->start )
+    {
+        mergeInterval(&Merged,interval);
+        return;
+    }
+    if ( Merged.start != 0 )
+        writeStore(&Merged);
+    Merged = *interval;
+}
+
+/* FNV-1a hash of `size` bytes, continuing `hash`.
+ */
+static uint64_t hashFNV ( uint64_t hash, const void *data, size_t size )
+{
+    const uint8_t *p = data;
+
+    while ( size-- )
+    {
+        hash ^= *p++;
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+/* Parse a line of a text log written by dumpViscaPacket() or dumpBadPacket():
+ * "HH:MM:SS[mmmm] CTL: 81 01 04 07 02 FF ... {...} - CMD: ...". The hex
+ * column has VISCA_MAX_SIZE cells of 3 characters. It's classified 8 bytes at
+ * once (SWAR): the flags of the hex digits and the spaces must match the
+ * pattern of the packet length, which is the number of hex digits / 2.
+ * Returns 1 for a packet, 0 for any other line and -1 for a broken packet.
+ */
+static int parseLogLine ( const char *s, size_t len, T_ImportRecord *rec )
+{
+    const char *hex = s+IMPORT_HEX_COLUMN;
+    uint64_t w, x, lower, digit, alpha, space, nonascii = 0;
+    uint64_t hexw[IMPORT_HEX_WORDS], spacew[IMPORT_HEX_WORDS], nibw[IMPORT_HEX_WORDS];
+    uint8_t nib[IMPORT_HEX_WORDS*8];
+    int i, cnt = 0, t[4];
+
+    if ( len < IMPORT_HEX_COLUMN || s[2]!=':' || s[5]!=':' || s[8]!='[' || s[13]!=']'
+         || s[14]!=' ' || s[18]!=':' || s[19]!=' ' )
+        return 0;
+    if ( memcmp(s+15,"CTL",3) == 0 )
+        rec->line = LINE_CTL;
+    else if ( memcmp(s+15,"CAM",3) == 0 )
+        rec->line = LINE_CAM;
+    else
+        return 0;                       // SPN:, PRX:, ...
+
+    for ( i=0; i<3; i++ )
+    {
+        if ( s[3*i] < '0' || s[3*i] > '9' || s[3*i+1] < '0' || s[3*i+1] > '9' )
+            return -1;
+        t[i] = (s[3*i]-'0')*10 + (s[3*i+1]-'0');
+    }
+    for ( i=9, t[3]=0; i<13; i++ )
+    {
+        if ( s[i] < '0' || s[i] > '9' )
+            return -1;
+        t[3] = t[3]*10 + (s[i]-'0');
+    }
+    if ( t[0] > 23 || t[1] > 59 || t[2] > 60 || t[3] > 999 || len < IMPORT_MIN_LINE )
+        return -1;
+    rec->msec = (uint32_t)(((t[0]*60 + t[1])*60 + t[2])*1000 + t[3]);
+
+    for ( i=0; i<IMPORT_HEX_WORDS; i++ )
+    {
+        memcpy(&w,hex+8*i,8);
+        nonascii |= w;
+        // the high bit of a byte is set if it's in the range
+        lower = w | SWAR(0x20);
+        digit = (w + SWAR(0x80-'0')) & ~(w + SWAR(0x7F-'9'));
+        alpha = (lower + SWAR(0x80-'a')) & ~(lower + SWAR(0x7F-'f'));
+        x = w ^ SWAR(' ');
+        space = ~(((x & SWAR(0x7F)) + SWAR(0x7F)) | x);
+        hexw[i] = (digit | alpha) & SWAR(0x80);
+        spacew[i] = space & SWAR(0x80);
+        // the value of a hex digit: low nibble, +9 for letters (bit 6)
+        nibw[i] = (w & SWAR(0x0F)) + 9*((w >> 6) & SWAR(0x01));
+        cnt += __builtin_popcountll(hexw[i]);
+    }
+    if ( (nonascii & SWAR(0x80)) || (cnt & 1) )
+        return -1;
+    cnt /= 2;
+    for ( i=0; i<IMPORT_HEX_WORDS; i++ )
+        if ( hexw[i] != ImportHex[cnt][i] || spacew[i] != ImportSpace[cnt][i] )
+            return -1;
+    if ( hex[VISCA_MAX_SIZE*3] == '{' )
+        rec->status = VISCA_SUCCESS;
+    else if ( len >= IMPORT_MIN_LINE+4 && memcmp(hex+VISCA_MAX_SIZE*3,"ERROR",5) == 0 )
+        rec->status = VISCA_FAILURE;
+    else
+        return -1;
+    if ( cnt == 0 )
+        return -1;
+
+    memcpy(nib,nibw,sizeof(nib));
+    for ( i=0; i<cnt; i++ )
+        rec->data[i] = (uint8_t)(nib[3*i] << 4 | nib[3*i+1]);
+    rec->num = (uint8_t)cnt;
+    return 1;
+}
+
+/* Thread of a chunk of the text log. The records get the day rollovers in
+ * the chunk, a day starts if the time goes back by more than IMPORT_ROLLOVER.
+ */
+static void *importChunk ( void *arg )
+{
+    T_ImportChunk *c = arg;
+    T_ImportRecord *rec;
+    const char *p, *nl;
+    size_t len;
+    int rc;
+
+    for ( p=c->start; p<c->end; p=nl+1 )
+    {
+        nl = memchr(p,'\n',c->end-p);
+        if ( !nl )
+            nl = c->end;
+        len = nl-p;
+        if ( len > 0 && p[len-1] == '\r' )
+            len--;
+        rec = &c->rec[c->cnt];
+        rc = parseLogLine(p,len,rec);
+        if ( rc == 0 )
+        {
+            c->other++;
+            continue;
+        }
+        if ( rc < 0 )
+        {
+            c->bad++;
+            continue;
+        }
+        if ( c->cnt == 0 )
+            c->first = rec->msec;
+        else if ( (long)rec->msec + IMPORT_ROLLOVER < (long)c->last )
+            c->days++;
+        rec->day = c->days;
+        c->last = rec->msec;
+        c->cnt++;
+    }
+    return NULL;
+}
+
+/* Parse the lines from `from` to `to`, split into a chunk per thread. Each
+ * chunk ends after a line. Returns the number of chunks used.
+ */
+static int importWindow ( const char *from, const char *to, T_ImportChunk *chunk, int threads )
+{
+    bool started[IMPORT_MAX_THREADS];
+    T_ImportChunk *c;
+    int i, n;
+
+    n = (to-from < (long)threads*IMPORT_MIN_CHUNK) ? (int)((to-from)/IMPORT_MIN_CHUNK) + 1 : threads;
+    for ( i=0; i<n; i++ )
+    {
+        c = &chunk[i];
+        c->start = (i == 0) ? from : chunk[i-1].end;
+        c->end = (i == n-1) ? to : from + (to-from)/n*(i+1);
+        if ( c->end < c->start )
+            c->end = c->start;
+        while ( c->end < to && c->end > c->start && c->end[-1] != '\n' )
+            c->end++;
+        c->cnt = 0;
+        c->days = 0;
+        c->other = c->bad = 0;
+        started[i] = (pthread_create(&c->thread,NULL,importChunk,c) == 0);
+        if ( !started[i] )
+            importChunk(c);                     // parse it in this thread
+    }
+    for ( i=0; i<n; i++ )
+        if ( started[i] )
+            pthread_join(chunk[i].thread,NULL);
+    return n;
+}
+
+/* Import a text log into a capture file. The log is memory mapped and parsed
+ * in windows of IMPORT_WINDOW bytes, each split into a chunk per CPU. The
+ * chunks are parsed in parallel, than the days are counted in order and the
+ * records are written. The log holds no date: the first day is `ImportDate`.
+ * Without it, the log is parsed twice: first to count the days back from the
+ * modification time of the log.
+ */
+static bool importLog ( const char *FileName, const char *CaptureFile )
+{
+    T_ImportChunk chunk[IMPORT_MAX_THREADS];
+    T_ImportChunk *c;
+    T_ImportRecord *rec;
+    T_Capture *cap;
+    struct timespec start;
+    struct timeval tick;
+    struct stat st;
+    struct tm tm, day0;
+    const char *data, *from, *to, *end;
+    uint8_t hexb[VISCA_MAX_SIZE*3], spaceb[VISCA_MAX_SIZE*3];
+    uint32_t prev = 0;
+    size_t j, packets = 0;
+    long other = 0, bad = 0, days = 0, day, midnight_day = -1;
+    time_t midnight = 0;
+    double parse_time = 0;
+    int fd, i, k, n, pass, threads;
+    bool seen;
+
+    for ( n=0; n<=VISCA_MAX_SIZE; n++ )
+    {
+        memset(hexb,0,sizeof(hexb));
+        memset(spaceb,0,sizeof(spaceb));
+        for ( k=0; k<VISCA_MAX_SIZE; k++ )
+        {
+            if ( k < n )
+            {
+                hexb[3*k] = hexb[3*k+1] = 0x80;
+                spaceb[3*k+2] = 0x80;
+            }
+            else
+                spaceb[3*k] = spaceb[3*k+1] = spaceb[3*k+2] = 0x80;
+        }
+        memcpy(ImportHex[n],hexb,sizeof(hexb));
+        memcpy(ImportSpace[n],spaceb,sizeof(spaceb));
+    }
+
+    memset(&day0,0,sizeof(day0));
+    if ( *ImportDate != '\0' )
+    {
+        if ( sscanf(ImportDate,"%4d-%2d-%2d",&day0.tm_year,&day0.tm_mon,&day0.tm_mday) != 3 )
+        {
+            fprintf(stderr,"ERROR: invalid date `%s'!\n",ImportDate);
+            return false;
+        }
+        day0.tm_year -= 1900;
+        day0.tm_mon -= 1;
+    }
+
+    fd = open(FileName,O_RDONLY);
+    if ( fd < 0 || fstat(fd,&st) != 0 || st.st_size == 0 )
+    {
+        fprintf(stderr,"ERROR: can't open log `%s' or it's empty!\n",FileName);
+        if ( fd >= 0 )
+            close(fd);
+        return false;
+    }
+    data = mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+    close(fd);
+    if ( data == MAP_FAILED )
+    {
+        fprintf(stderr,"ERROR: can't map log `%s'!\n",FileName);
+        return false;
+    }
+    madvise((void *)data,st.st_size,MADV_SEQUENTIAL);
+    end = data+st.st_size;
+    if ( *ImportDate == '\0' )
+    {
+        localtime_r(&st.st_mtime,&day0);
+        day0.tm_hour = day0.tm_min = day0.tm_sec = 0;
+    }
+
+    threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if ( threads < 1 )
+        threads = 1;
+    if ( threads > IMPORT_MAX_THREADS )
+        threads = IMPORT_MAX_THREADS;
+    memset(chunk,0,sizeof(chunk));
+    for ( i=0; i<threads; i++ )
+    {
+        chunk[i].rec = malloc((IMPORT_WINDOW/threads/IMPORT_MIN_LINE + 4) * sizeof(T_ImportRecord));
+        if ( !chunk[i].rec )
+        {
+            fputs("ERROR: importLog(): out of memory\n",stderr);
+            while ( i-- > 0 )
+                free(chunk[i].rec);
+            munmap((void *)data,st.st_size);
+            return false;
+        }
+    }
+    cap = openCapture(CaptureFile,false);
+    if ( !cap )
+    {
+        for ( i=0; i<threads; i++ )
+            free(chunk[i].rec);
+        munmap((void *)data,st.st_size);
+        return false;
+    }
+
+    for ( pass=(*ImportDate=='\0') ? 0 : 1; pass<2; pass++ )
+    {
+        clock_gettime(CLOCK_MONOTONIC,&start);
+        seen = false;
+        days = 0;
+        for ( from=data; from<end; from=to )
+        {
+            to = (end-from > IMPORT_WINDOW) ? from+IMPORT_WINDOW : end;
+            while ( to < end && to > from && to[-1] != '\n' )
+                to--;                           // the window ends after a line
+            if ( to == from )
+                to = (end-from > IMPORT_WINDOW) ? from+IMPORT_WINDOW : end;
+            n = importWindow(from,to,chunk,threads);
+
+            for ( i=0; i<n; i++ )
+            {
+                c = &chunk[i];
+                other += c->other;
+                bad += c->bad;
+                if ( c->cnt == 0 )
+                    continue;
+                if ( seen && (long)c->first + IMPORT_ROLLOVER < (long)prev )
+                    days++;
+                seen = true;
+                prev = c->last;
+                for ( j=0; pass==1 && j<c->cnt; j++ )
+                {
+                    rec = &c->rec[j];
+                    day = days + rec->day;
+                    if ( day != midnight_day )
+                    {
+                        tm = day0;
+                        tm.tm_mday += (int)day;
+                        tm.tm_isdst = -1;
+                        midnight = mktime(&tm);
+                        midnight_day = day;
+                    }
+                    tick.tv_sec = midnight + rec->msec/1000;
+                    tick.tv_usec = (suseconds_t)(rec->msec%1000)*1000;
+                    writeCapture(cap,rec->line,rec->status,&tick,rec->data,rec->num,0);
+                }
+                if ( pass == 1 )
+                    packets += c->cnt;
+                days += c->days;
+            }
+        }
+        if ( pass == 0 )
+        {
+            day0.tm_mday -= (int)days;          // the log ends at the modification time
+            other = bad = 0;
+        }
+        parse_time = benchTime(&start);
+    }
+    closeCapture(cap);
+    for ( i=0; i<threads; i++ )
+        free(chunk[i].rec);
+    munmap((void *)data,st.st_size);
+    fprintf(stderr,"INFO: imported %zu packets (%ld broken, %ld other lines) of %ld days from %.1f MB in %.2fs (%.0f MB/s), %d threads\n",
+            packets,bad,other,days+1,st.st_size/1e6,parse_time,st.st_size/1e6/parse_time,threads);
+    return true;
+}
+
+/* Write the HTML report of a capture. The capture is memory mapped and split
+ * into a range of blocks per CPU, which are analysed in parallel (see
+ * T_ReportChunk). With `range` > 0, only the last `range` seconds of the
+ * capture are reported. The report holds the aggregated data only, no
+ * packets.
+ */
+static bool writeReport ( const char *FileName, const char *ReportFile, long range )
+{
+    T_ReportChunk *chunk;
+    T_CaptureHeader hdr;
+    T_Report *r;
+    struct timespec start;
+    struct stat st;
+    const uint8_t *data;
+    int64_t first = 0, last = 0, from, t0, t1;
+    uint32_t blocks, lo, hi, mid, b0;
+    long packets = 0;
+    bool started[IMPORT_MAX_THREADS];
+    int fd, i, threads;
+    FILE *out;
+
+    clock_gettime(CLOCK_MONOTONIC,&start);
+    fd = open(FileName,O_RDONLY);
+    if ( fd < 0 || fstat(fd,&st) != 0 || st.st_size < CAPTURE_BLOCK )
+    {
+        fprintf(stderr,"ERROR: can't open capture file `%s' or it's empty!\n",FileName);
+        if ( fd >= 0 )
+            close(fd);
+        return false;
+    }
+    data = mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+    close(fd);
+    if ( data == MAP_FAILED )
+    {
+        fprintf(stderr,"ERROR: can't map capture file `%s'!\n",FileName);
+        return false;
+    }
+    blocks = (uint32_t)(st.st_size/CAPTURE_BLOCK);
+    memcpy(&hdr,data,sizeof(hdr));
+    if ( strcmp(hdr.magic,CAPTURE_MAGIC)!=0 || hdr.block_size!=CAPTURE_BLOCK )
+    {
+        fprintf(stderr,"ERROR: `%s' is no capture file!\n",FileName);
+        munmap((void *)data,st.st_size);
+        return false;
+    }
+
+    // the time covered: the first and the last packet
+    reportTimes(data,sizeof(hdr),&first,&t1);
+    while ( blocks > 0 && !reportTimes(data+(size_t)(blocks-1)*CAPTURE_BLOCK,blocks==1 ? sizeof(hdr) : 0,&t1,&last) )
+        blocks--;                           // preallocated, never written
+    if ( blocks == 0 )
+    {
+        fprintf(stderr,"ERROR: capture file `%s' holds no packets!\n",FileName);
+        munmap((void *)data,st.st_size);
+        return false;
+    }
+    from = (range > 0) ? last - (int64_t)range*1000000 : first;
+    if ( from < first )
+        from = first;
+
+    // the first block of the range: the last one starting before
+    b0 = 0;
+    lo = 1;
+    hi = blocks;
+    while ( lo < hi )
+    {
+        mid = lo + (hi-lo)/2;
+        if ( reportTimes(data+(size_t)mid*CAPTURE_BLOCK,0,&t0,&t1) && t0 <= from )
+        {
+            b0 = mid;
+            lo = mid+1;
+        }
+        else
+            hi = mid;
+    }
+
+    threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if ( threads > (int)((blocks-b0)/REPORT_MIN_BLOCKS) )
+        threads = (int)((blocks-b0)/REPORT_MIN_BLOCKS);
+    if ( threads > IMPORT_MAX_THREADS )
+        threads = IMPORT_MAX_THREADS;
+    if ( threads < 1 )
+        threads = 1;
+    chunk = calloc(threads,sizeof(T_ReportChunk));
+    r = calloc(threads,sizeof(T_Report));
+    if ( !SequencesPrepared )
+        prepareSequences();                 // not within the threads
+    if ( !chunk || !r )
+    {
+        fputs("ERROR: writeReport(): out of memory\n",stderr);
+        free(chunk);
+        free(r);
+        munmap((void *)data,st.st_size);
+        return false;
+    }
+    madvise((void *)(data+(size_t)b0*CAPTURE_BLOCK),(size_t)(blocks-b0)*CAPTURE_BLOCK,MADV_WILLNEED);
+    for ( i=0; i<threads; i++ )
+    {
+        chunk[i].data = data;
+        chunk[i].first = b0 + (uint32_t)((uint64_t)(blocks-b0)*i/threads);
+        chunk[i].last = b0 + (uint32_t)((uint64_t)(blocks-b0)*(i+1)/threads);
+        chunk[i].warm = (chunk[i].first > 0) ? chunk[i].first-1 : 0;
+        chunk[i].from = from;
+        chunk[i].start = from;
+        chunk[i].span = last-from+1;
+        chunk[i].rep = &r[i];
+        started[i] = (pthread_create(&chunk[i].thread,NULL,reportChunk,&chunk[i]) == 0);
+        if ( !started[i] )
+            reportChunk(&chunk[i]);         // analyse it in this thread
+    }
+    for ( i=0; i<threads; i++ )
+    {
+        if ( started[i] )
+            pthread_join(chunk[i].thread,NULL);
+        if ( i > 0 )
+            reportMerge(&r[0],&r[i]);
+        packets += chunk[i].packets;
+    }
+
+    out = fopen(ReportFile,"w");
+    if ( out )
+    {
+        reportHtml(out,FileName,&r[0],from,last,packets,threads);
+        if ( fclose(out) != 0 )
+            out = NULL;
+    }
+    if ( !out )
+        fprintf(stderr,"ERROR: can't write report `%s'!\n",ReportFile);
+    else
+        fprintf(stderr,"INFO: report `%s' of %u blocks (%ld packets, %.1f MB) in %.2fs, %d threads\n",
+                ReportFile,blocks-b0,packets,(blocks-b0)*(double)CAPTURE_BLOCK/1e6,benchTime(&start),threads);
+    free(chunk);
+    free(r);
+    munmap((void *)data,st.st_size);
+    return out != NULL;
+}
+
+/* The thread of a range of blocks, see T_ReportChunk.
+ */
+static void *reportChunk ( void *arg )
+{
+    T_ReportChunk *c = arg;
+    uint32_t k;
+
+    for ( k=c->warm; k<c->last; k++ )
+        reportBlock(c,c->data+(size_t)k*CAPTURE_BLOCK,k==0 ? sizeof(T_CaptureHeader) : 0,k >= c->first);
+    return NULL;
+}
+
+/* Analyse the records of a capture block, starting at `pos`. The packets are
+ * decoded at once by findCommands(). Without `count`, only the transactions
+ * are tracked.
+ */
+static void reportBlock ( T_ReportChunk *c, const uint8_t *block, size_t pos, bool count )
+{
+    T_CaptureRecord rec;
+    uint64_t usec;
+    int i, n = 0;
+
+    while ( pos+sizeof(rec) <= CAPTURE_BLOCK )
+    {
+        memcpy(&rec,block+pos,sizeof(rec));
+        if ( rec.line == CAPTURE_PAD )
+            break;
+        if ( rec.num > VISCA_MAX_SIZE || pos+sizeof(rec)+rec.num > CAPTURE_BLOCK )
+        {
+            fputs("ERROR: reportBlock(): bad record\n",stderr);
+            break;
+        }
+        memcpy(&usec,rec.usec,sizeof(usec));
+        if ( rec.flags & CAPTURE_INJECTED )
+        {
+            pos += sizeof(rec)+rec.num;
+            continue;                   // not on a line
+        }
+        c->offset[n] = (uint32_t)(pos+sizeof(rec));
+        c->length[n] = rec.num;
+        c->line[n] = (rec.line == LINE_CTL+1) ? LINE_CTL : LINE_CAM;
+        c->status[n] = rec.status;
+        c->flags[n] = rec.flags;
+        c->usec[n] = (int64_t)usec;
+        n++;
+        pos += sizeof(rec)+rec.num;
+    }
+    findCommands(block,CAPTURE_BLOCK,c->offset,c->length,n,c->id,c->address,c->sock,c->param);
+    for ( i=0; i<n; i++ )
+        reportPacket(c,i,block+c->offset[i],count && c->usec[i] >= c->from);
+}
+
+/* Track the transactions with trackReply(), like trackTransaction() does.
+ * Broadcasts and the initialisation of the chain aren't reported.
+ */
+static void reportPacket ( T_ReportChunk *c, int i, const uint8_t *b, bool count )
+{
+    T_Report *r = c->rep;
+    T_Transaction *t;
+    struct timeval received;
+    int address = c->address[i], cmd = c->id[i], j, k;
+
+    if ( count )
+    {
+        c->packets++;
+        r->line[c->line[i]].packets++;
+        r->line[c->line[i]].bytes += c->length[i];
+        if ( c->status[i] != VISCA_SUCCESS )
+            r->line[c->line[i]].errors++;
+        else if ( cmd == 0 )
+            r->line[c->line[i]].unknown++;
+    }
+    if ( c->status[i] != VISCA_SUCCESS || cmd < 0 )
+        return;
+    received.tv_sec = (time_t)(c->usec[i]/1000000);
+    received.tv_usec = (suseconds_t)(c->usec[i]%1000000);
+
+    if ( c->line[i] == LINE_CTL )
+    {
+        if ( address == VISCA_BROADCAST && cmd == CMD_IfClear )
+        {
+            for ( k=1; count && k<=VISCA_MAX_CAMERAS; k++ )
+            {
+                if ( c->track[k].pending.active )
+                    reportSlo(r,k,&c->track[k].pending,NULL,true);
+                for ( j=1; j<=VISCA_SOCKETS; j++ )
+                    if ( c->track[k].socket[j].active )
+                        reportSlo(r,k,&c->track[k].socket[j],NULL,true);
+            }
+            memset(c->track,0,sizeof(c->track));
+        }
+        if ( address < 1 || address > VISCA_MAX_CAMERAS )
+            return;
+        if ( count )
+        {
+            r->sent[address]++;
+            if ( isInquiry(cmd) )
+            {
+                r->polls[address]++;
+                r->poll_bytes += c->length[i];
+            }
+        }
+        if ( c->flags[i] & CAPTURE_PROXY )
+            return;                     // answered by the proxy
+        t = &c->track[address].pending;
+        if ( t->active && count )
+            reportSlo(r,address,t,NULL,true);       // no reply at all
+        t->active = true;
+        t->sent = received;
+        timerclear(&t->acked);
+        t->cmd = cmd;
+        k = cmd ? sequences[cmd-1].comparable+1 : VISCA_MAX_SIZE;
+        t->param = (k < c->length[i]-1) ? b[k] : 0;        // for the objectives
+        return;
+    }
+
+    if ( address < 1 || address > VISCA_MAX_CAMERAS )
+        return;
+    if ( cmd == RPL_Version && c->track[address].pending.active && c->track[address].pending.cmd == CMD_VersionInq )
+    {
+        r->cam[address].vendor = (uint16_t)(b[2] << 8 | b[3]);
+        r->cam[address].model = (uint16_t)(b[4] << 8 | b[5]);
+        r->cam[address].rom = (uint16_t)(b[6] << 8 | b[7]);
+    }
+    if ( (b[1] & 0xF0) == VISCA_TYPE_RESPONSE_ERROR && count )
+        r->codes[b[2]]++;
+    switch ( trackReply(&c->track[address],b[1] & 0xF0,b[1] & 0x0F,&received,&t) )
+    {
+        case TRACK_Ack:
+            if ( count )
+                histAdd(&r->cam[address].ack,timeDiffUs(&t->sent,&t->acked)/1000);
+            break;
+        case TRACK_Done:
+            reportComplete(c,address,t,&received,false,count);
+            break;
+        case TRACK_Failed:
+            reportComplete(c,address,t,&received,true,count);
+            break;
+        default:
+            break;
+    }
+}
+
+/* The transaction `t` of the camera `address` is finished.
+ */
+static void reportComplete ( T_ReportChunk *c, int address, T_Transaction *t, const struct timeval *end, bool failed, bool count )
+{
+    T_Report *r = c->rep;
+    T_IntervalCommand *cmd = &r->cmd[(t->cmd > 0 && t->cmd < RPL_Address) ? t->cmd : 0];
+    int sock = (t == &c->track[address].pending) ? 0 : (int)(t - c->track[address].socket);
+    T_ReportSlow slow;
+    int64_t sent, col;
+
+    t->active = false;
+    if ( !count )
+        return;
+    r->cam[address].transactions++;
+    cmd->cnt++;
+    reportSlo(r,address,t,end,failed);
+    if ( sock && timerisset(&t->acked) )
+        r->busy[address][sock] += (uint64_t)timeDiffUs(&t->acked,end);
+    if ( failed )
+    {
+        r->cam[address].errors++;
+        cmd->errors++;
+        return;
+    }
+    histAdd(&r->cam[address].done,timeDiffUs(&t->sent,end)/1000);
+    histAdd(&cmd->done,timeDiffUs(&t->sent,end)/1000);
+    sent = (int64_t)t->sent.tv_sec*1000000 + t->sent.tv_usec;
+    col = (sent - c->start) * REPORT_COLUMNS / c->span;
+    if ( col < 0 )
+        col = 0;
+    histAdd(&r->heat[address][col],timeDiffUs(&t->sent,end)/1000);
+
+    slow.sent = sent;
+    slow.latency = timeDiffUs(&t->sent,end);
+    slow.ack = timerisset(&t->acked) ? timeDiffUs(&t->sent,&t->acked) : -1;
+    slow.cmd = (int16_t)t->cmd;
+    slow.address = (int8_t)address;
+    reportSlow(r,&slow);
+}
+
+/* Count a transaction for the objectives (-O), like countSlo(). Without any
+ * reply (`end` is NULL), it's bad.
+ */
+static void reportSlo ( T_Report *r, int address, const T_Transaction *t, const struct timeval *end, bool failed )
+{
+    int i;
+
+    for ( i=0; i<SloCount; i++ )
+    {
+        if ( !matchSlo(&Slo[i],address,t) )
+            continue;
+        r->slo_total[i]++;
+        if ( isGoodSlo(&Slo[i],t,end,failed) )
+            r->slo_good[i]++;
+    }
+}
+
+/* Keep the REPORT_SLOW slowest transactions. Of the same latency, the
+ * earlier one is kept, so the result doesn't depend on the threads.
+ */
+static void reportSlow ( T_Report *r, const T_ReportSlow *slow )
+{
+    int i, min = 0;
+
+    if ( r->slows < REPORT_SLOW )
+    {
+        r->slow[r->slows++] = *slow;
+        return;
+    }
+    for ( i=1; i<REPORT_SLOW; i++ )
+        if ( isSlower(&r->slow[min],&r->slow[i]) )
+            min = i;
+    if ( isSlower(slow,&r->slow[min]) )
+        r->slow[min] = *slow;
+}
+
+/* Order of the slowest transactions: the slower first, than the earlier.
+ */
+static bool isSlower ( const T_ReportSlow *a, const T_ReportSlow *b )
+{
+    return a->latency > b->latency || (a->latency == b->latency && a->sent < b->sent);
+}
+
+/* Add the report `from` to `to`.
+ */
+static void reportMerge ( T_Report *to, const T_Report *from )
+{
+    int i, j;
+
+    for ( i=0; i<MAX_LINES; i++ )
+    {
+        to->line[i].packets += from->line[i].packets;
+        to->line[i].bytes += from->line[i].bytes;
+        to->line[i].errors += from->line[i].errors;
+        to->line[i].unknown += from->line[i].unknown;
+    }
+    for ( i=0; i<=VISCA_MAX_CAMERAS; i++ )
+    {
+        if ( from->cam[i].vendor || from->cam[i].model )
+        {
+            to->cam[i].vendor = from->cam[i].vendor;
+            to->cam[i].model = from->cam[i].model;
+            to->cam[i].rom = from->cam[i].rom;
+        }
+        to->cam[i].transactions += from->cam[i].transactions;
+        to->cam[i].errors += from->cam[i].errors;
+        histMerge(&to->cam[i].ack,&from->cam[i].ack);
+        histMerge(&to->cam[i].done,&from->cam[i].done);
+        for ( j=0; j<REPORT_COLUMNS; j++ )
+            histMerge(&to->heat[i][j],&from->heat[i][j]);
+        for ( j=0; j<=VISCA_SOCKETS; j++ )
+            to->busy[i][j] += from->busy[i][j];
+        to->sent[i] += from->sent[i];
+        to->polls[i] += from->polls[i];
+    }
+    for ( i=0; i<RPL_Address; i++ )
+    {
+        to->cmd[i].cnt += from->cmd[i].cnt;
+        to->cmd[i].errors += from->cmd[i].errors;
+        histMerge(&to->cmd[i].done,&from->cmd[i].done);
+    }
+    to->poll_bytes += from->poll_bytes;
+    for ( i=0; i<256; i++ )
+        to->codes[i] += from->codes[i];
+    for ( i=0; i<from->slows; i++ )
+        reportSlow(to,&from->slow[i]);
+    for ( i=0; i<SLO_MAX; i++ )
+    {
+        to->slo_good[i] += from->slo_good[i];
+        to->slo_total[i] += from->slo_total[i];
+    }
+}
+
+/* Get the time of the first and the last record of a block. Returns false
+ * if the block holds no record.
+ */
+static bool reportTimes ( const uint8_t *block, size_t pos, int64_t *first, int64_t *last )
+{
+    T_CaptureRecord rec;
+    uint64_t usec;
+    bool found = false;
+
+    while ( pos+sizeof(rec) <= CAPTURE_BLOCK )
+    {
+        memcpy(&rec,block+pos,sizeof(rec));
+        if ( rec.line == CAPTURE_PAD || rec.num > VISCA_MAX_SIZE )
+            break;
+        memcpy(&usec,rec.usec,sizeof(usec));
+        if ( !found )
+            *first = (int64_t)usec;
+        *last = (int64_t)usec;
+        found = true;
+        pos += sizeof(rec)+rec.num;
+    }
+    return found;
+}
+
+/* Write the report as a single HTML page, the heatmaps are inline SVG.
+ */
+static void reportHtml ( FILE *out, const char *FileName, const T_Report *r, int64_t start, int64_t end,
+                         long packets, int threads )
+{
+    static const char *codes[] =
+    {
+        "", "message length", "syntax", "buffer full", "cancelled", "no socket"
+    };
+    static const double percent[] = { 50, 90, 99 };
+    T_IntervalCamera all;
+    T_Histogram heat[REPORT_COLUMNS];
+    const T_IntervalCamera *cam;
+    T_ReportSlow slow[REPORT_SLOW], tmp;
+    double seconds = (end-start+1)/1e6;
+    uint32_t sent = 0, polls = 0;
+    int order[RPL_Address];
+    time_t now;
+    double burn;
+    int i, j, k, n;
+
+    memset(&all,0,sizeof(all));
+    memset(heat,0,sizeof(heat));
+    for ( i=1; i<=VISCA_MAX_CAMERAS; i++ )
+    {
+        all.transactions += r->cam[i].transactions;
+        all.errors += r->cam[i].errors;
+        histMerge(&all.ack,&r->cam[i].ack);
+        histMerge(&all.done,&r->cam[i].done);
+        for ( j=0; j<REPORT_COLUMNS; j++ )
+            histMerge(&heat[j],&r->heat[i][j]);
+        sent += r->sent[i];
+        polls += r->polls[i];
+    }
+
+    time(&now);
+    fputs("<!DOCTYPE html>\n<html><head><meta charset=\"utf-8\"><title>visca-dump report</title>\n"
+          "<style>\n"
+          "body{font-family:sans-serif;margin:2em;color:#222}\n"
+          "table{border-collapse:collapse;margin-bottom:1.5em}\n"
+          "th,td{border:1px solid #ccc;padding:2px 8px;text-align:right}\n"
+          "th{background:#eee}td.l,th.l{text-align:left}\n"
+          "</style>\n<script>\n",out);
+    fputs("var bounds=[",out);
+    for ( i=0; i<HIST_BUCKETS; i++ )
+        fprintf(out,i ? ",%ld" : "%ld",histLowerBound(i));
+    fprintf(out,"],cell=%d,left=%d;\n",REPORT_CELL,REPORT_LEFT);
+    fputs("function heatmap(id,d,rows,from,to){\n"
+          " var c=document.getElementById(id),x=c.getContext('2d'),max=1;\n"
+          " d.forEach(function(col){col.forEach(function(v){if(v>max)max=v;});});\n"
+          " d.forEach(function(col,i){col.forEach(function(v,j){\n"
+          "  if(!v)return;var s=Math.log(1+v)/Math.log(1+max);\n"
+          "  x.fillStyle='rgb('+(255-Math.round(55*s))+','+Math.round(230*(1-s))+','+Math.round(200*(1-s))+')';\n"
+          "  x.fillRect(left+i*cell,(rows-1-j)*cell,cell,cell);});});\n"
+          " x.font='10px sans-serif';x.fillStyle='#444';x.textAlign='right';\n"
+          " for(var j=0;j<rows;j+=4)x.fillText(bounds[j]+' ms',left-4,(rows-j)*cell);\n"
+          " x.fillText(to,left+d.length*cell,rows*cell+15);x.textAlign='left';x.fillText(from,left,rows*cell+15);\n"
+          " c.onmousemove=function(e){var i=Math.floor((e.offsetX-left)/cell),j=rows-1-Math.floor(e.offsetY/cell),\n"
+          "  v=(d[i]&&d[i][j])||0;c.title=(i>=0&&j>=0&&j<rows)?bounds[j]+' ms: '+v:'';};\n"
+          "}\n</script></head><body>\n",out);
+    fputs("<h1>VISCA report: ",out);
+    reportText(out,FileName);
+    fprintf(out,"</h1>\n<p>%s",reportDate(start));
+    fprintf(out," &ndash; %s (%.1f hours), %ld packets.",reportDate(end),seconds/3600.0,packets);
+    fprintf(out," Created %s by visca-dump %s with %d threads.</p>\n",reportDate((int64_t)now*1000000),VERSION,threads);
+
+    fprintf(out,"<h2>Summary</h2>\n<table>\n<tr><th class=\"l\"></th><th>CTL</th><th>CAM</th></tr>\n");
+    fprintf(out,"<tr><td class=\"l\">packets</td><td>%u</td><td>%u</td></tr>\n",r->line[LINE_CTL].packets,r->line[LINE_CAM].packets);
+    fprintf(out,"<tr><td class=\"l\">bytes</td><td>%u</td><td>%u</td></tr>\n",r->line[LINE_CTL].bytes,r->line[LINE_CAM].bytes);
+    fprintf(out,"<tr><td class=\"l\">line load</td><td>%.2f%%</td><td>%.2f%%</td></tr>\n",
+            r->line[LINE_CTL].bytes*VISCA_BYTE_TIME/1e4/seconds,r->line[LINE_CAM].bytes*VISCA_BYTE_TIME/1e4/seconds);
+    fprintf(out,"<tr><td class=\"l\">bad packets</td><td>%u</td><td>%u</td></tr>\n",r->line[LINE_CTL].errors,r->line[LINE_CAM].errors);
+    fprintf(out,"<tr><td class=\"l\">unknown packets</td><td>%u</td><td>%u</td></tr>\n</table>\n",r->line[LINE_CTL].unknown,r->line[LINE_CAM].unknown);
+    fprintf(out,"<p>%u transactions, %u failed (%.2f%%). Polling share: %.1f%% of the controller packets and %.1f%% of the CTL bytes are inquiries.</p>\n",
+            all.transactions,all.errors,all.transactions ? all.errors*100.0/all.transactions : 0.0,
+            sent ? polls*100.0/sent : 0.0,r->line[LINE_CTL].bytes ? r->poll_bytes*100.0/r->line[LINE_CTL].bytes : 0.0);
+
+    if ( SloCount > 0 )
+    {
+        fputs("<h2>Service level objectives</h2>\n<table>\n<tr><th class=\"l\">objective</th><th>transactions</th>"
+              "<th>bad</th><th>good</th><th>burn</th><th>budget left</th></tr>\n",out);
+        for ( i=0; i<SloCount; i++ )
+        {
+            burn = burnSlo(r->slo_good[i],r->slo_total[i],Slo[i].objective);
+            fputs("<tr><td class=\"l\">",out);
+            reportText(out,Slo[i].spec);
+            fprintf(out,"</td><td>%llu</td><td>%llu</td><td>%.3f%%</td><td>%.2f</td><td>%.1f%%</td></tr>\n",
+                    (unsigned long long)r->slo_total[i],(unsigned long long)(r->slo_total[i]-r->slo_good[i]),
+                    r->slo_total[i] ? r->slo_good[i]*100.0/r->slo_total[i] : 100.0,burn,100.0*(1.0-burn));
+        }
+        fputs("</table>\n<p>Over the reported time. A transaction without any reply is bad.</p>\n",out);
+    }
+
+    fputs("<h2>Cameras</h2>\n<table>\n<tr><th class=\"l\">camera</th><th class=\"l\">model</th><th>transactions</th><th>errors</th>"
+          "<th>ACK p50</th><th>p90</th><th>p99</th><th>done p50</th><th>p90</th><th>p99</th>",out);
+    for ( j=1; j<=VISCA_SOCKETS; j++ )
+        fprintf(out,"<th>socket %d</th>",j);
+    fputs("<th>polling</th></tr>\n",out);
+    for ( i=0; i<=VISCA_MAX_CAMERAS; i++ )
+    {
+        cam = (i == 0) ? &all : &r->cam[i];
+        if ( i > 0 && cam->transactions == 0 && r->sent[i] == 0 )
+            continue;
+        if ( i == 0 )
+            fputs("<tr><th class=\"l\">all</th><td></td>",out);
+        else if ( cam->vendor || cam->model )
+            fprintf(out,"<tr><td class=\"l\">cam%d</td><td class=\"l\">%4.4X/%4.4X rom %4.4X</td>",i,cam->vendor,cam->model,cam->rom);
+        else
+            fprintf(out,"<tr><td class=\"l\">cam%d</td><td></td>",i);
+        fprintf(out,"<td>%u</td><td>%u</td>",cam->transactions,cam->errors);
+        for ( k=0; k<3; k++ )
+            fprintf(out,"<td>%ld</td>",histPercentile(&cam->ack,percent[k]));
+        for ( k=0; k<3; k++ )
+            fprintf(out,"<td>%ld</td>",histPercentile(&cam->done,percent[k]));
+        for ( j=1; j<=VISCA_SOCKETS; j++ )
+        {
+            if ( i > 0 )
+                fprintf(out,"<td>%.1f%%</td>",r->busy[i][j]/1e4/seconds);
+            else
+                fputs("<td></td>",out);
+        }
+        fprintf(out,"<td>%.1f%%</td></tr>\n",(i ? r->sent[i] : sent) ? (i ? r->polls[i] : polls)*100.0/(i ? r->sent[i] : sent) : 0.0);
+    }
+    fputs("</table>\n<p>Times in [ms], -1 without data. A socket is occupied from the ACK to the completion.\n"
+          "Polling is the share of inquiries among the controller packets.</p>\n",out);
+
+    fputs("<h2>Commands</h2>\n<table>\n<tr><th class=\"l\">command</th><th>count</th><th>errors</th>"
+          "<th>done p50</th><th>p90</th><th>p99</th></tr>\n",out);
+    // by count, the largest first
+    for ( n=0, i=0; i<RPL_Address; i++ )
+    {
+        if ( r->cmd[i].cnt == 0 )
+            continue;
+        for ( j=n++; j>0 && r->cmd[order[j-1]].cnt < r->cmd[i].cnt; j-- )
+            order[j] = order[j-1];
+        order[j] = i;
+    }
+    for ( j=0; j<n; j++ )
+    {
+        k = order[j];
+        fprintf(out,"<tr><td class=\"l\">%s</td><td>%u</td><td>%u</td>",
+                k ? SequenceNames[k] : "unknown",r->cmd[k].cnt,r->cmd[k].errors);
+        for ( i=0; i<3; i++ )
+            fprintf(out,"<td>%ld</td>",histPercentile(&r->cmd[k].done,percent[i]));
+        fputs("</tr>\n",out);
+    }
+    fputs("</table>\n",out);
+
+    fputs("<h2>Completion latency</h2>\n",out);
+    reportHeatmap(out,0,"all cameras",heat,start,end);
+    for ( i=1; i<=VISCA_MAX_CAMERAS; i++ )
+    {
+        char title[16];
+
+        if ( r->cam[i].done.cnt == 0 )
+            continue;
+        snprintf(title,sizeof(title),"cam%d",i);
+        reportHeatmap(out,i,title,r->heat[i],start,end);
+    }
+
+    fputs("<h2>Errors</h2>\n<table>\n<tr><th class=\"l\">error reply</th><th>count</th></tr>\n",out);
+    for ( i=0; i<256; i++ )
+    {
+        if ( r->codes[i] == 0 )
+            continue;
+        fprintf(out,"<tr><td class=\"l\">%2.2X %s</td><td>%u</td></tr>\n",i,
+                (i < (int)(sizeof(codes)/sizeof(codes[0]))) ? codes[i] : (i == 0x41) ? "not executable" : "",r->codes[i]);
+    }
+    fprintf(out,"<tr><td class=\"l\">bad packets CTL/CAM</td><td>%u/%u</td></tr>\n</table>\n",
+            r->line[LINE_CTL].errors,r->line[LINE_CAM].errors);
+
+    // the slowest first
+    memcpy(slow,r->slow,sizeof(slow));
+    for ( i=1; i<r->slows; i++ )
+        for ( j=i; j>0 && isSlower(&slow[j],&slow[j-1]); j-- )
+        {
+            tmp = slow[j];
+            slow[j] = slow[j-1];
+            slow[j-1] = tmp;
+        }
+    fputs("<h2>Slowest transactions</h2>\n<table>\n<tr><th class=\"l\">sent</th><th class=\"l\">camera</th>"
+          "<th class=\"l\">command</th><th>ACK</th><th>done</th></tr>\n",out);
+    for ( i=0; i<r->slows; i++ )
+    {
+        fprintf(out,"<tr><td class=\"l\">%s</td><td class=\"l\">cam%d</td><td class=\"l\">%s</td>",
+                reportDate(slow[i].sent),slow[i].address,
+                (slow[i].cmd > 0 && slow[i].cmd < RPL_Address) ? SequenceNames[slow[i].cmd] : "unknown");
+        if ( slow[i].ack >= 0 )
+            fprintf(out,"<td>%.1f</td>",slow[i].ack/1000.0);
+        else
+            fputs("<td></td>",out);
+        fprintf(out,"<td>%.1f</td></tr>\n",slow[i].latency/1000.0);
+    }
+    fputs("</table>\n</body></html>\n",out);
+}
+
+/* A heatmap of the completion latency: a column per REPORT_COLUMNS-th of the
+ * time, a row per bucket of the histograms. The buckets are embedded as data
+ * and drawn into a canvas by the script of reportHtml(), the color is the
+ * logarithm of the count.
+ */
+static void reportHeatmap ( FILE *out, int id, const char *title, const T_Histogram *heat, int64_t start, int64_t end )
+{
+    int rows = 0, i, j, n;
+
+    for ( i=0; i<REPORT_COLUMNS; i++ )
+        for ( j=0; j<HIST_BUCKETS; j++ )
+            if ( heat[i].bucket[j] && j >= rows )
+                rows = j+1;
+    fprintf(out,"<h3>%s</h3>\n<canvas id=\"heat%d\" width=\"%d\" height=\"%d\"></canvas>\n<script>heatmap(\"heat%d\",[",
+            title,id,REPORT_LEFT+REPORT_COLUMNS*REPORT_CELL+10,rows*REPORT_CELL+30,id);
+    for ( i=0; i<REPORT_COLUMNS; i++ )
+    {
+        for ( n=HIST_BUCKETS; n>0 && heat[i].bucket[n-1]==0; n-- )
+            ;
+        fputs(i ? ",[" : "[",out);
+        for ( j=0; j<n; j++ )
+            fprintf(out,j ? ",%u" : "%u",heat[i].bucket[j]);
+        fputc(']',out);
+    }
+    fprintf(out,"],%d,\"%s\",",rows,reportDate(start));
+    fprintf(out,"\"%s\");</script>\n",reportDate(end));
+}
+
+/* Write a text with the HTML special characters escaped.
+ */
+static void reportText ( FILE *out, const char *text )
+{
+    for ( ; *text; text++ )
+    {
+        switch ( *text )
+        {
+            case '<':  fputs("&lt;",out); break;
+            case '>':  fputs("&gt;",out); break;
+            case '&':  fputs("&amp;",out); break;
+            case '"':  fputs("&quot;",out); break;
+            default:   fputc(*text,out); break;
+        }
+    }
+}
+
+/* Return the local time "YYYY-MM-DD HH:MM:SS". The returned pointer
+ * references a static buffer, so the next call to this functions modifies
+ * the content!
+ */
+static const char *reportDate ( int64_t usec )
+{
+    static char date_str[32];
+    time_t sec = (time_t)(usec/1000000);
+    struct tm t;
+
+    if ( !localtime_r(&sec,&t) || strftime(date_str,sizeof(date_str),"%Y-%m-%d %H:%M:%S",&t) == 0 )
+        strcpy(date_str,"NULL");
+    return date_str;
+}
+
+#ifdef HAVE_LUA
+/* The count hook of the script. If the CPU time of the script thread is
+ * beyond the deadline, the hook is aborted.
+ */
+static void scriptBudgetHook ( lua_State *L, lua_Debug *ar )
+{
+    struct timespec now;
+
+    (void)ar;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID,&now);
+    if ( now.tv_sec > ScriptDeadline.tv_sec
+         || (now.tv_sec == ScriptDeadline.tv_sec && now.tv_nsec > ScriptDeadline.tv_nsec) )
+        luaL_error(L,"time budget exceeded");
+}
+
+/* ev:byte(i) returns the byte `i` (counting from 1) of a packet.
+ */
+static int scriptEventByte ( lua_State *L )
+{
+    lua_Integer i;
+
+    luaL_checkudata(L,1,"visca.event");
+    i = luaL_checkinteger(L,2);
+    if ( !ScriptCurrent || i < 1 || i > ScriptCurrent->num )
+        lua_pushnil(L);
+    else
+        lua_pushinteger(L,ScriptCurrent->data[i-1]);
+    return 1;
+}
+
+/* The __index of the event. The fields are read from the queued event. Each
+ * event type has its own fields, the others are nil.
+ */
+static int scriptEventIndex ( lua_State *L )
+{
+    const T_ScriptEvent *ev = ScriptCurrent;
+    const char *key;
+    bool packet, transaction, interval;
+
+    luaL_checkudata(L,1,"visca.event");
+    key = luaL_checkstring(L,2);
+    if ( !ev )
+        return luaL_error(L,"event used outside of its hook");
+    packet = (ev->type == SCRIPT_Packet);
+    transaction = (ev->type == SCRIPT_Transaction);
+    interval = (ev->type == SCRIPT_Interval);
+    if ( strcmp(key,"time")==0 )
+        lua_pushnumber(L,(lua_Number)ev->tick.tv_sec + (lua_Number)ev->tick.tv_usec/1e6);
+    else if ( !interval && strcmp(key,"cmd")==0 )
+        lua_pushinteger(L,ev->cmd);
+    else if ( !interval && strcmp(key,"name")==0 )
+        lua_pushstring(L,(ev->cmd >= 0 && ev->cmd < CMD_MAX_SEQUENCES) ? SequenceNames[ev->cmd] : "");
+    else if ( !interval && strcmp(key,"address")==0 )
+        lua_pushinteger(L,ev->address);
+    else if ( packet && strcmp(key,"line")==0 )
+        lua_pushstring(L,ev->line==LINE_CTL ? "CTL" : "CAM");
+    else if ( packet && strcmp(key,"num")==0 )
+        lua_pushinteger(L,ev->num);
+    else if ( packet && strcmp(key,"valid")==0 )
+        lua_pushboolean(L,ev->status==VISCA_SUCCESS);
+    else if ( packet && strcmp(key,"byte")==0 )
+        lua_pushcfunction(L,scriptEventByte);
+    else if ( packet && strcmp(key,"data")==0 )
+        lua_pushlstring(L,(const char *)ev->data,ev->num);
+    else if ( transaction && strcmp(key,"latency")==0 )
+        lua_pushinteger(L,ev->latency);
+    else if ( transaction && strcmp(key,"ack")==0 )
+        lua_pushinteger(L,ev->ack);
+    else if ( transaction && strcmp(key,"failed")==0 )
+        lua_pushboolean(L,ev->failed);
+    else if ( interval && strcmp(key,"packets_ctl")==0 )
+        lua_pushinteger(L,ev->packets[LINE_CTL]);
+    else if ( interval && strcmp(key,"packets_cam")==0 )
+        lua_pushinteger(L,ev->packets[LINE_CAM]);
+    else if ( interval && strcmp(key,"errors_ctl")==0 )
+        lua_pushinteger(L,ev->errors[LINE_CTL]);
+    else if ( interval && strcmp(key,"errors_cam")==0 )
+        lua_pushinteger(L,ev->errors[LINE_CAM]);
+    else if ( interval && strcmp(key,"transactions")==0 )
+        lua_pushinteger(L,ev->transactions);
+    else if ( interval && strcmp(key,"slo_burn")==0 )
+        lua_pushnumber(L,ev->slo_burn);
+    else if ( interval && strcmp(key,"slo_budget")==0 )
+        lua_pushnumber(L,ev->slo_budget);
+    else
+        lua_pushnil(L);
+    return 1;
+}
+
+/* The script thread. Each queued event is passed to its hook. The hook gets
+ * the "event" object, which reads the fields of the queued event.
+ */
+static void *scriptWorker ( void *arg )
+{
+    const struct timespec idle = { 0, SCRIPT_IDLE*1000000L };
+    unsigned tail;
+    int ref = *(int *)arg;
+    int rc;
+
+    for ( ;; )
+    {
+        tail = atomic_load_explicit(&ScriptTail,memory_order_relaxed);
+        if ( tail == atomic_load_explicit(&ScriptHead,memory_order_acquire) )
+        {
+            if ( atomic_load(&ScriptStop) )
+                break;
+            nanosleep(&idle,NULL);
+            continue;
+        }
+        ScriptCurrent = &ScriptQueue[tail & (SCRIPT_QUEUE-1)];
+        lua_getglobal(Script,ScriptHooks[ScriptCurrent->type]);
+        lua_rawgeti(Script,LUA_REGISTRYINDEX,ref);
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID,&ScriptDeadline);
+        ScriptDeadline.tv_nsec += ScriptBudget[ScriptCurrent->type]*1000L;
+        ScriptDeadline.tv_sec += ScriptDeadline.tv_nsec / 1000000000L;
+        ScriptDeadline.tv_nsec %= 1000000000L;
+        rc = lua_pcall(Script,1,0,0);
+        if ( rc != LUA_OK )
+        {
+            const char *msg = lua_tostring(Script,-1);
+
+            if ( msg && strstr(msg,"time budget exceeded") )
+                atomic_fetch_add(&ScriptOverrun[ScriptCurrent->type],1);
+            else
+            {
+                if ( atomic_fetch_add(&ScriptFailed[ScriptCurrent->type],1) == 0 )
+                    fprintf(stderr,"ERROR: script: %s\n",msg ? msg : "?");
+            }
+            lua_pop(Script,1);
+        }
+        ScriptCurrent = NULL;
+        atomic_store_explicit(&ScriptTail,tail+1,memory_order_release);
+    }
+    return NULL;
+}
+#endif
+
+/* Load the analysis script and start the script thread. The script may define
+ * the hooks `on_packet(ev)`, `on_transaction(ev)`, `on_interval(ev)` and
+ * `on_exit()`.
+ */
+static bool openScript ( const char *FileName )
+{
+#ifdef HAVE_LUA
+    static int ref;
+    int i;
+
+    Script = luaL_newstate();
+    if ( !Script )
+        return false;
+    luaL_openlibs(Script);
+    if ( luaL_loadfile(Script,FileName) != LUA_OK || lua_pcall(Script,0,0,0) != LUA_OK )
+    {
+        fprintf(stderr,"ERROR: can't load script `%s': %s\n",FileName,lua_tostring(Script,-1));
+        lua_close(Script);
+        Script = NULL;
+        return false;
+    }
+    for ( i=0; i<SCRIPT_MAX_EVENTS; i++ )
+    {
+        lua_getglobal(Script,ScriptHooks[i]);
+        ScriptHasHook[i] = lua_isfunction(Script,-1);
+        lua_pop(Script,1);
+    }
+
+    /* a single event object is used for all calls
+     */
+    lua_newuserdata(Script,1);
+    luaL_newmetatable(Script,"visca.event");
+    lua_pushcfunction(Script,scriptEventIndex);
+    lua_setfield(Script,-2,"__index");
+    lua_setmetatable(Script,-2);
+    ref = luaL_ref(Script,LUA_REGISTRYINDEX);
+
+    ScriptQueue = calloc(SCRIPT_QUEUE,sizeof(T_ScriptEvent));
+    if ( !ScriptQueue )
+    {
+        fputs("ERROR: openScript(): out of memory\n",stderr);
+        lua_close(Script);
+        Script = NULL;
+        return false;
+    }
+    atomic_init(&ScriptHead,0);
+    atomic_init(&ScriptTail,0);
+    atomic_init(&ScriptStop,false);
+    lua_sethook(Script,scriptBudgetHook,LUA_MASKCOUNT,SCRIPT_COUNT);
+    if ( pthread_create(&ScriptThread,NULL,scriptWorker,&ref) != 0 )
+    {
+        fputs("ERROR: openScript(): can't start the script thread\n",stderr);
+        lua_close(Script);
+        Script = NULL;
+        free(ScriptQueue);
+        ScriptQueue = NULL;
+        return false;
+    }
+    fprintf(stderr,"INFO: script `%s' loaded\n",FileName);
+    return true;
+#else
+    fprintf(stderr,"ERROR: can't load script `%s', compiled without Lua!\n",FileName);
+    return false;
+#endif
+}
+
+/* Process the rest of the queue, stop the script thread and call `on_exit()`.
+ */
+static void closeScript ( void )
+{
+#ifdef HAVE_LUA
+    if ( !Script )
+        return;
+    atomic_store(&ScriptStop,true);
+    pthread_join(ScriptThread,NULL);
+    lua_sethook(Script,NULL,0,0);
+    lua_getglobal(Script,"on_exit");
+    if ( lua_isfunction(Script,-1) )
+    {
+        if ( lua_pcall(Script,0,0,0) != LUA_OK )
+        {
+            fprintf(stderr,"ERROR: script: %s\n",lua_tostring(Script,-1));
+            lua_pop(Script,1);
+        }
+    }
+    else
+        lua_pop(Script,1);
+    lua_close(Script);
+    Script = NULL;
+    free(ScriptQueue);
+    ScriptQueue = NULL;
+#endif
+}
+
+/* Return the next free event of the script queue, or NULL if no script has a
+ * hook for this type. If the queue is full, the event is dropped. The event
+ * is passed to the script by postScriptEvent(). This is called by the capture
+ * thread, so it never waits.
+ */
+static T_ScriptEvent *queueScriptEvent ( int type )
+{
+#ifdef HAVE_LUA
+    T_ScriptEvent *ev;
+    unsigned head;
+
+    if ( !Script || !ScriptHasHook[type] )
+        return NULL;
+    head = atomic_load_explicit(&ScriptHead,memory_order_relaxed);
+    if ( head - atomic_load_explicit(&ScriptTail,memory_order_acquire) >= SCRIPT_QUEUE )
+    {
+        ScriptDropped[type]++;
+        return NULL;
+    }
+    ev = &ScriptQueue[head & (SCRIPT_QUEUE-1)];
+    memset(ev,0,sizeof(*ev));           // no fields of a former event
+    ev->type = (uint8_t)type;
+    return ev;
+#else
+    (void)type;
+    return NULL;
+#endif
+}
+
+static void postScriptEvent ( void )
+{
+#ifdef HAVE_LUA
+    atomic_fetch_add_explicit(&ScriptHead,1,memory_order_release);
+#endif
+}
+
+/* In the proxy mode, a packet received by `from` is forwarded to `to`. Even
+ * bad data is forwarded.
+ */
+static void forwardPacket ( T_VISCAInterface *from, T_VISCAInterface *to, uint8_t rc )
+{
+    (void)rc;
+    if ( !Proxy || from->num <= 0 )
+        return;
+    if ( v24Write(to->uart,from->buffer,from->num) != from->num )
+        fprintf(stderr,"ERROR(%s): forward failed!\n",to->name);
+}
+
+/* Send a VersionInq to each known camera once. The inquiry is only sent if the
+ * camera has no open transaction. The reply is decoded by decodeVersion().
+ */
+static void injectInquiries ( const struct timeval *now )
+{
+    T_Camera *cam;
+    int i, j;
+
+    for ( i=1; i<=VISCA_MAX_CAMERAS; i++ )
+    {
+        cam = &cameras[i];
+        if ( !cam->present || cam->version || cam->injected || cam->track.pending.active || PrefetchCam == i )
+            continue;
+        for ( j=1; j<=VISCA_SOCKETS; j++ )
+            if ( cam->track.socket[j].active )
+                break;
+        if ( j <= VISCA_SOCKETS )
+            continue;
+        injected.buffer[0] = 0x80 | i;
+        memcpy(&injected.buffer[1],sequences[CMD_VersionInq-1].seq,sequences[CMD_VersionInq-1].length);
+        injected.buffer[1+sequences[CMD_VersionInq-1].length] = VISCA_TERMINATOR;
+        injected.num = sequences[CMD_VersionInq-1].length+2;
+        injected.received = *now;
+        injected.cmd = CMD_VersionInq;
+        injected.valid = true;
+        if ( v24Write(receiver.uart,injected.buffer,injected.num) != injected.num )
+        {
+            fprintf(stderr,"ERROR(%s): VersionInq failed!\n",receiver.name);
+            continue;
+        }
+        cam->injected = true;
+        cam->asked = *now;
+        writeCapture(Capture,LINE_CTL,VISCA_SUCCESS,now,injected.buffer,injected.num,CAPTURE_INJECTED|CAPTURE_OWN);
+        dumpViscaPacket(&injected,0L);
+    }
+}
+
+/* Check if a version reply of `cam` answers the VersionInq injected by the
+ * proxy. A VersionInq of the controller takes precedence.
+ */
+static bool isInjectedReply ( const T_Camera *cam, const T_VISCAInterface *interface )
+{
+    return cam->injected && !cam->version
+           && timeDiff(&cam->asked,&interface->received) < VERSION_TIMEOUT
+           && !(cam->track.pending.active && cam->track.pending.cmd==CMD_VersionInq);
+}
+
+/* Check if a packet of the cameras is the reply to the VersionInq injected by
+ * the proxy. It isn't forwarded and isn't tracked as transaction.
+ */
+static bool isInjectedVersion ( const T_VISCAInterface *interface, uint8_t rc )
+{
+    return Proxy && rc==VISCA_SUCCESS && interface->cmd==RPL_Version
+           && interface->address>=1 && interface->address<=VISCA_MAX_CAMERAS
+           && isInjectedReply(&cameras[interface->address],interface);
+}
+
+/* Decode a reply to CAM_VersionInq: "y0 50 GG GG HH HH JJ JJ KK FF" with the
+ * vendor (G), model (H), ROM version (J) and number of sockets (K). The reply
+ * is only decoded if a VersionInq was sent, by the controller or by the proxy
+ * (`own`). Returns true if it was decoded.
+ */
+static bool decodeVersion ( T_VISCAInterface *interface, bool own )
+{
+    T_Camera *cam = &cameras[interface->address];
+    const uint8_t *b = interface->buffer;
+
+    if ( interface->address < 1 || interface->address > VISCA_MAX_CAMERAS || interface->num < 10 )
+        return false;
+    if ( !own && !(cam->track.pending.active && cam->track.pending.cmd==CMD_VersionInq) )
+        return false;
+    cam->vendor = (uint16_t)(b[2] << 8 | b[3]);
+    cam->model = (uint16_t)(b[4] << 8 | b[5]);
+    cam->rom = (uint16_t)(b[6] << 8 | b[7]);
+    cam->sockets = b[8];
+    if ( !cam->version && !Quiet )
+        printf("%s SPN: version       cam%d  vendor=%4.4X model=%4.4X rom=%4.4X sockets=%d\n",
+               logTime(&interface->received,false),interface->address,
+               cam->vendor,cam->model,cam->rom,cam->sockets);
+    cam->version = true;
+    return true;
+}
+
+/* Open the shadow port and start the reader thread of the shadow camera.
+ */
+static bool openShadow ( const char *PortName )
+{
+    if ( !setupInterface(&shadow,PortName,"SHD") )
+        return false;
+    if ( v24QueryFileHandle(shadow.uart) < 0 )
+    {
+        fputs("ERROR: no file handle of the shadow port!\n",stderr);
+        v24ClosePort(shadow.uart);
+        shadow.uart = NULL;
+        return false;
+    }
+    if ( pipe2(ShadowWake,O_NONBLOCK|O_CLOEXEC) != 0 )
+    {
+        fputs("ERROR: can't create the pipe of the shadow thread!\n",stderr);
+        v24ClosePort(shadow.uart);
+        shadow.uart = NULL;
+        return false;
+    }
+    atomic_init(&ShadowHead,0);
+    atomic_init(&ShadowTail,0);
+    atomic_init(&ShadowStop,false);
+    if ( pthread_create(&ShadowThread,NULL,shadowReader,NULL) != 0 )
+    {
+        fputs("ERROR: can't start the shadow thread!\n",stderr);
+        close(ShadowWake[0]);
+        close(ShadowWake[1]);
+        ShadowWake[0] = ShadowWake[1] = -1;
+        v24ClosePort(shadow.uart);
+        shadow.uart = NULL;
+        return false;
+    }
+    return true;
+}
+
+/* Stop the reader thread, dump the final comparison and close the port.
+ */
+static void closeShadow ( void )
+{
+    int rc;
+
+    if ( !shadow.uart )
+        return;
+    atomic_store(&ShadowStop,true);
+    pthread_join(ShadowThread,NULL);
+    close(ShadowWake[0]);
+    close(ShadowWake[1]);
+    ShadowWake[0] = ShadowWake[1] = -1;
+    dumpShadow();
+    rc = v24ClosePort(shadow.uart);
+    shadow.uart = NULL;
+    if ( rc != V24_E_OK )
+        dumpErrorMessage(rc);
+    else
+        fputs("INFO: shadow port closed!\n", stderr);
+}
+
+/* Copy the packet of the controller to the shadow camera. This is called
+ * right after the packet was forwarded to the primary camera. The primary
+ * path only copies the packet into the bounded queue and wakes the shadow
+ * thread, which writes it to the shadow port. If the queue is full, the packet
+ * is dropped and counted. A command is queued with the receive time of the
+ * packet, the same start as used for the primary camera.
+ */
+static void teeShadow ( uint8_t rc )
+{
+    static const uint8_t wake = 1;
+    T_ShadowCommand *c;
+    unsigned head;
+
+    if ( !shadow.uart || sender.num <= 0 )
+        return;
+    head = atomic_load_explicit(&ShadowHead,memory_order_relaxed);
+    if ( head - atomic_load_explicit(&ShadowTail,memory_order_acquire) >= SHADOW_QUEUE )
+    {
+        ShadowDropped++;
+        return;
+    }
+    c = &ShadowQueue[head & (SHADOW_QUEUE-1)];
+    memcpy(c->data,sender.buffer,sender.num);
+    c->num = (uint8_t)sender.num;
+    clock_gettime(CLOCK_MONOTONIC,&c->queued);
+    c->track = (rc == VISCA_SUCCESS && sender.valid && sender.cmd >= 0 && sender.cmd != CMD_SetAdress);
+    if ( c->track )
+    {
+        c->cmd = (int16_t)sender.cmd;
+        c->address = (int8_t)(sender.broadcast ? 0 : sender.address);
+        c->sent = sender.received;
+    }
+    atomic_store_explicit(&ShadowHead,head+1,memory_order_release);
+    if ( write(ShadowWake[1],&wake,1) < 0 )
+        return;                         // the pipe is full, the thread is woken anyway
+}
+
+/* The shadow thread. It writes the queued packets to the shadow port and
+ * waits for the replies of the shadow camera, so the main loop never blocks
+ * on the shadow port. A command is tracked once it's written, before the
+ * camera can reply to it.
+ */
+static void *shadowReader ( void *arg )
+{
+    struct pollfd pfd[2];
+    struct timespec written;
+    T_ShadowCommand *c;
+    T_Camera *cam;
+    unsigned tail, head;
+    uint8_t drain[64];
+    uint8_t rc;
+    bool ok;
+    long us;
+    int i, j, n;
+
+    (void)arg;
+    pfd[0].fd = v24QueryFileHandle(shadow.uart);
+    pfd[0].events = POLLIN;
+    pfd[1].fd = ShadowWake[0];
+    pfd[1].events = POLLIN;
+    while ( !atomic_load(&ShadowStop) )
+    {
+        n = poll(pfd,2,SHADOW_POLL);
+        if ( n > 0 && (pfd[1].revents & POLLIN) )
+            while ( read(ShadowWake[0],drain,sizeof(drain)) > 0 )
+                ;
+
+        tail = atomic_load_explicit(&ShadowTail,memory_order_relaxed);
+        head = atomic_load_explicit(&ShadowHead,memory_order_acquire);
+        for ( ; tail != head; tail++ )
+        {
+            c = &ShadowQueue[tail & (SHADOW_QUEUE-1)];
+            ok = (v24Write(shadow.uart,c->data,c->num) == c->num);
+            clock_gettime(CLOCK_MONOTONIC,&written);
+            us = (written.tv_sec-c->queued.tv_sec)*1000000L + (written.tv_nsec-c->queued.tv_nsec)/1000L;
+
+            pthread_mutex_lock(&ShadowLock);
+            if ( !ok )
+                ShadowFailed++;
+            else
+            {
+                histAdd(&ShadowTee,us);     // [us], the overflow is >= 4096us
+                if ( us > ShadowTeeMax )
+                    ShadowTeeMax = us;
+            }
+            if ( ok && c->track )
+            {
+                if ( c->address == 0 && c->cmd == CMD_IfClear )
+                {
+                    for ( i=0; i<=VISCA_MAX_CAMERAS; i++ )
+                    {
+                        ShadowStats.cam[i].track.pending.active = false;
+                        for ( j=1; j<=VISCA_SOCKETS; j++ )
+                            ShadowStats.cam[i].track.socket[j].active = false;
+                    }
+                }
+                cam = &ShadowStats.cam[(int)c->address];
+                if ( cam->track.pending.active )
+                    ShadowStats.lost++;
+                cam->track.pending.active = true;
+                cam->track.pending.cmd = c->cmd;
+                cam->track.pending.sent = c->sent;
+            }
+            pthread_mutex_unlock(&ShadowLock);
+        }
+        atomic_store_explicit(&ShadowTail,tail,memory_order_release);
+
+        if ( n <= 0 || !(pfd[0].revents & POLLIN) )
+            continue;
+        rc = getViscaPacket(&shadow);
+        if ( rc == VISCA_HAVE_NO_DATA )
+            continue;
+        pthread_mutex_lock(&ShadowLock);
+        ShadowStats.packets++;
+        if ( rc != VISCA_SUCCESS )
+            ShadowStats.errors++;
+        else
+            trackShadow(&shadow);
+        pthread_mutex_unlock(&ShadowLock);
+    }
+    return NULL;
+}
+
+/* Track a reply of the shadow camera, like trackTransaction() does for the
+ * primary cameras. The initialisation and the groups aren't tracked.
+ */
+static void trackShadow ( const T_VISCAInterface *interface )
+{
+    T_Camera *cam;
+    T_Transaction *t;
+    int address, sock;
+
+    if ( !interface->valid || interface->cmd < 0 )
+        return;
+    if ( interface->broadcast )
+    {
+        if ( ShadowStats.cam[0].track.pending.active && interface->cmd == ShadowStats.cam[0].track.pending.cmd )
+            completeShadow(0,&ShadowStats.cam[0].track.pending,&interface->received,false);
+        return;
+    }
+    address = interface->address;
+    if ( address < 1 || address > VISCA_MAX_CAMERAS )
+        return;
+    cam = &ShadowStats.cam[address];
+    sock = interface->buffer[1] & 0x0F;
+    switch ( trackReply(&cam->track,interface->type,sock,&interface->received,&t) )
+    {
+        case TRACK_Done:
+            completeShadow(address,t,&interface->received,false);
+            break;
+        case TRACK_Failed:
+            completeShadow(address,t,&interface->received,true);
+            break;
+        default:
+            break;
+    }
+}
+
+/* Complete a transaction of the shadow camera. Like for the primary cameras,
+ * only the commands to a single camera are counted.
+ */
+static void completeShadow ( int address, T_Transaction *t, const struct timeval *end, bool failed )
+{
+    T_IntervalCommand *c = &ShadowStats.cmd[(t->cmd > 0 && t->cmd < RPL_Address) ? t->cmd : 0];
+
+    t->active = false;
+    if ( address == 0 )
+        return;
+    c->cnt++;
+    if ( failed )
+        c->errors++;
+    else
+        histAdd(&c->done,timeDiff(&t->sent,end));
+}
+
+/* Dump the comparison of the primary and the shadow camera. Each value is
+ * given as primary/shadow.
+ */
+static void dumpShadow ( void )
+{
+    const T_IntervalCommand *p, *s;
+    int i;
+
+    pthread_mutex_lock(&ShadowLock);
+    printf("~~~~~~~~~~~~~~~~~~~ shadow: packets=%ld errors=%ld lost=%ld | dropped=%ld failed=%ld | tee p99/max=%ld/%ld [us]\n",
+           ShadowStats.packets,ShadowStats.errors,ShadowStats.lost,ShadowDropped,ShadowFailed,
+           (histPercentile(&ShadowTee,99) > ShadowTeeMax) ? ShadowTeeMax : histPercentile(&ShadowTee,99),ShadowTeeMax);
+    for ( i=0; i<RPL_Address; i++ )
+    {
+        p = &ShadowPrimary[i];
+        s = &ShadowStats.cmd[i];
+        if ( p->cnt == 0 && s->cnt == 0 )
+            continue;
+        printf("~~~~~~~~~~~~~~~~~~~ shadow %-22s cnt=%u/%u errors=%u/%u | done p50=%ld/%ld p90=%ld/%ld p99=%ld/%ld [ms]\n",
+               SequenceNames[i],p->cnt,s->cnt,p->errors,s->errors,
+               histPercentile(&p->done,50),histPercentile(&s->done,50),
+               histPercentile(&p->done,90),histPercentile(&s->done,90),
+               histPercentile(&p->done,99),histPercentile(&s->done,99));
+    }
+    pthread_mutex_unlock(&ShadowLock);
+}
+
+/* Return the cache entry of an inquiry of a camera. If there is none and
+ * `create` is set, the entry asked the longest time ago is reused.
+ */
+static T_CacheEntry *findCacheEntry ( int address, int cmd, bool create )
+{
+    T_CacheEntry *e, *oldest = NULL;
+    int i;
+
+    for ( i=0; i<CACHE_ENTRIES; i++ )
+    {
+        e = &InquiryCache[address][i];
+        if ( e->cmd == cmd )
+            return e;
+        if ( !oldest || e->cmd == 0 || (oldest->cmd != 0 && timercmp(&e->asked,&oldest->asked,<)) )
+            oldest = e;
+    }
+    if ( !create )
+        return NULL;
+    if ( oldest == PrefetchEntry )
+        PrefetchEntry = NULL;           // the reply of the prefetch is dropped
+    memset(oldest,0,sizeof(*oldest));
+    oldest->cmd = cmd;
+    return oldest;
+}
+
+/* Answer an inquiry of the controller from the cache. A command clears the
+ * cache of its camera. Returns true if the inquiry was answered, so it isn't
+ * forwarded to the camera. The reply is dumped as packet of the proxy.
+ */
+static bool serveInquiry ( uint8_t rc )
+{
+    T_CacheEntry *e;
+    int i, j;
+
+    if ( CacheTTL <= 0 || rc != VISCA_SUCCESS || !sender.valid || sender.cmd <= 0 )
+        return false;
+    if ( PrefetchCam )
+        PrefetchPreempted++;            // forwarded without waiting
+    if ( !isInquiry(sender.cmd) )
+    {
+        for ( i=sender.broadcast?1:sender.address; i<=(sender.broadcast?VISCA_MAX_CAMERAS:sender.address); i++ )
+            for ( j=0; j<CACHE_ENTRIES && i>=1 && i<=VISCA_MAX_CAMERAS; j++ )
+                InquiryCache[i][j].stored.tv_sec = 0;
+        return false;
+    }
+    if ( sender.broadcast || sender.address < 1 || sender.address > VISCA_MAX_CAMERAS )
+        return false;
+
+    e = findCacheEntry(sender.address,sender.cmd,true);
+    memcpy(e->request,sender.buffer,sender.num);
+    e->request_num = sender.num;
+    e->asked = sender.received;
+    CacheAsks++;
+    if ( e->stored.tv_sec == 0 || timeDiff(&e->stored,&sender.received) > CacheTTL )
+        return false;
+    if ( v24Write(sender.uart,e->reply,e->reply_num) != e->reply_num )
+        return false;
+    CacheHits++;
+    if ( e->prefetched )
+    {
+        PrefetchUsed++;
+        e->prefetched = false;
+    }
+    memcpy(injected.buffer,e->reply,e->reply_num);
+    injected.num = e->reply_num;
+    getTime(&injected.received);
+    decodePacket(&injected);
+    // the reply goes first, the inquiry is written by handlePacket()
+    writeCapture(Capture,LINE_CAM,VISCA_SUCCESS,&injected.received,injected.buffer,injected.num,CAPTURE_INJECTED);
+    sender.cached = true;
+    return true;
+}
+
+/* Keep the reply of the camera to an inquiry of the controller in the cache.
+ * This is called before the transaction is completed.
+ */
+static void cacheReply ( uint8_t rc )
+{
+    T_CacheEntry *e;
+    T_Camera *cam;
+
+    if ( CacheTTL <= 0 || rc != VISCA_SUCCESS || !receiver.valid || receiver.broadcast
+         || receiver.address < 1 || receiver.address > VISCA_MAX_CAMERAS
+         || receiver.buffer[1] != VISCA_TYPE_RESPONSE_COMPLETED )
+        return;
+    cam = &cameras[receiver.address];
+    if ( !cam->track.pending.active || !isInquiry(cam->track.pending.cmd) )
+        return;
+    e = findCacheEntry(receiver.address,cam->track.pending.cmd,false);
+    if ( !e )
+        return;
+    memcpy(e->reply,receiver.buffer,receiver.num);
+    e->reply_num = receiver.num;
+    e->stored = receiver.received;
+    e->prefetched = false;
+}
+
+/* Check if a packet of the camera is the reply to the open prefetch. The
+ * camera replies in order and no other inquiry was open when the prefetch
+ * was sent, so it's the first inquiry reply of the camera. A "buffer full"
+ * belongs to a command of the controller. Returns true if the packet was
+ * taken, it isn't forwarded to the controller.
+ */
+static bool prefetchReply ( uint8_t rc )
+{
+    if ( !PrefetchCam || rc != VISCA_SUCCESS || !receiver.valid || receiver.address != PrefetchCam )
+        return false;
+    if ( receiver.buffer[1] != VISCA_TYPE_RESPONSE_COMPLETED
+         && !(receiver.buffer[1] == VISCA_TYPE_RESPONSE_ERROR && receiver.buffer[2] != 0x03) )
+        return false;
+    PrefetchLine += receiver.num * VISCA_BYTE_TIME;
+    if ( PrefetchEntry && receiver.buffer[1] == VISCA_TYPE_RESPONSE_COMPLETED )
+    {
+        memcpy(PrefetchEntry->reply,receiver.buffer,receiver.num);
+        PrefetchEntry->reply_num = receiver.num;
+        PrefetchEntry->stored = receiver.received;
+        PrefetchEntry->prefetched = true;
+    }
+    PrefetchCam = 0;
+    PrefetchEntry = NULL;
+    return true;
+}
+
+/* Refresh a cached inquiry if both lines are quiet. The line time used is
+ * limited by a credit, which grows by PrefetchCap percent of the time. Only
+ * one prefetch is open at once and only to a camera without an open command.
+ * The inquiry polled most recently by the controller is refreshed first, if
+ * its reply is older than half of the cache time. The inquiry is dumped as
+ * PRX: and captured like the one of -V.
+ */
+static void prefetchInquiries ( void )
+{
+    struct timeval now;
+    T_CacheEntry *e, *best = NULL;
+    T_Camera *cam;
+    long cost, age;
+    int i, j, address = 0;
+
+    getTime(&now);
+    if ( PrefetchLast.tv_sec == 0 )
+        PrefetchStart = PrefetchLast = now;
+    PrefetchCredit += ((now.tv_sec-PrefetchLast.tv_sec)*1000000L + (now.tv_usec-PrefetchLast.tv_usec)) * PrefetchCap;
+    PrefetchLast = now;
+    if ( PrefetchCredit > PREFETCH_BURST*1000L*100L )
+        PrefetchCredit = PREFETCH_BURST*1000L*100L;
+
+    if ( PrefetchCam )
+    {
+        if ( timeDiff(&PrefetchSent,&now) < PREFETCH_TIMEOUT )
+            return;
+        PrefetchLost++;
+        PrefetchCam = 0;
+        PrefetchEntry = NULL;
+    }
+    if ( timeDiff(&LastTraffic,&now) < PREFETCH_IDLE )
+        return;
+
+    for ( i=1; i<=VISCA_MAX_CAMERAS; i++ )
+    {
+        cam = &cameras[i];
+        if ( !cam->present || cam->track.pending.active || (cam->injected && !cam->version) )
+            continue;
+        for ( j=1; j<=VISCA_SOCKETS; j++ )
+            if ( cam->track.socket[j].active )
+                break;
+        if ( j <= VISCA_SOCKETS )
+            continue;
+        for ( j=0; j<CACHE_ENTRIES; j++ )
+        {
+            e = &InquiryCache[i][j];
+            if ( e->cmd == 0 || e->request_num == 0 || timeDiff(&e->asked,&now) > PREFETCH_ACTIVE )
+                continue;
+            age = e->stored.tv_sec ? timeDiff(&e->stored,&now) : CacheTTL;
+            if ( age < CacheTTL/2 )
+                continue;
+            if ( !best || timercmp(&e->asked,&best->asked,>) )
+            {
+                best = e;
+                address = i;
+            }
+        }
+    }
+    if ( !best )
+        return;
+    cost = (best->request_num + (best->reply_num ? best->reply_num : PREFETCH_REPLY)) * VISCA_BYTE_TIME;
+    if ( PrefetchCredit < cost*100L )
+        return;
+    if ( v24Write(receiver.uart,best->request,best->request_num) != best->request_num )
+        return;
+    PrefetchCredit -= cost*100L;
+    PrefetchLine += best->request_num * VISCA_BYTE_TIME;
+    PrefetchCnt++;
+    PrefetchCam = address;
+    PrefetchEntry = best;
+    PrefetchSent = now;
+
+    memcpy(injected.buffer,best->request,best->request_num);
+    injected.num = best->request_num;
+    injected.received = now;
+    decodePacket(&injected);
+    writeCapture(Capture,LINE_CTL,VISCA_SUCCESS,&now,injected.buffer,injected.num,CAPTURE_INJECTED|CAPTURE_OWN);
+    dumpViscaPacket(&injected,0L);
+}
+
+/* Hold a command of the controller, if its camera has reached the limit of
+ * open commands or older commands are held already. A full queue is answered
+ * by the proxy with "buffer full", like the camera would do. Returns true if
+ * the packet was held, it's processed by releasePackets() later.
+ */
+static bool holdPacket ( uint8_t rc )
+{
+    T_Pace *p;
+    T_PacePacket *q;
+
+    if ( PaceCeiling <= 0 || rc != VISCA_SUCCESS || !sender.valid || sender.cmd < 0 || sender.broadcast
+         || sender.address < 1 || sender.address > VISCA_MAX_CAMERAS
+         || (sender.buffer[1] != 0x01 && sender.buffer[1] != 0x09) )
+        return false;           // a cancel or broadcast isn't held
+    p = &Pace[sender.address];
+    if ( p->head == p->tail && isAdmitted(sender.address,sender.cmd,&sender.received) )
+        return false;
+    if ( p->head - p->tail >= PACE_QUEUE )
+    {
+        injected.buffer[0] = (uint8_t)((sender.address+8) << 4);
+        injected.buffer[1] = VISCA_TYPE_RESPONSE_ERROR;
+        injected.buffer[2] = 0x03;
+        injected.buffer[3] = VISCA_TERMINATOR;
+        injected.num = 4;
+        if ( v24Write(sender.uart,injected.buffer,injected.num) != injected.num )
+            fprintf(stderr,"ERROR(%s): buffer full failed!\n",sender.name);
+        getTime(&injected.received);
+        decodePacket(&injected);
+        writeCapture(Capture,LINE_CAM,VISCA_SUCCESS,&injected.received,injected.buffer,injected.num,CAPTURE_INJECTED);
+        sender.cached = true;
+        p->rejected++;
+        return false;
+    }
+    q = &p->queue[p->head++ % PACE_QUEUE];
+    memcpy(q->buffer,sender.buffer,sender.num);
+    q->num = sender.num;
+    q->type = sender.type;
+    q->address = sender.address;
+    q->cmd = sender.cmd;
+    q->received = sender.received;
+    p->held++;
+    return true;
+}
+
+/* Forward the held commands which are admitted now. A released packet is
+ * processed as if it was received from the controller right now, so the
+ * transaction times are the ones of the camera. The time held is kept apart.
+ */
+static void releasePackets ( const struct timeval *now )
+{
+    T_Pace *p;
+    T_PacePacket *q;
+    int i;
+
+    for ( i=1; i<=VISCA_MAX_CAMERAS; i++ )
+    {
+        p = &Pace[i];
+        while ( p->head != p->tail )
+        {
+            q = &p->queue[p->tail % PACE_QUEUE];
+            if ( !isAdmitted(i,q->cmd,now) )
+                break;
+            p->tail++;
+            histAdd(&p->wait,timeDiff(&q->received,now));
+            memcpy(sender.buffer,q->buffer,q->num);
+            sender.num = q->num;
+            sender.type = q->type;
+            sender.address = q->address;
+            sender.broadcast = 0;
+            sender.cmd = q->cmd;
+            sender.received = *now;
+            sender.valid = true;
+            sender.cached = false;
+            sender.timedout = false;
+            getTime(&LastTraffic);
+            forwardPacket(&sender,&receiver,VISCA_SUCCESS);
+            teeShadow(VISCA_SUCCESS);
+            writeCapture(Capture,LINE_CTL,VISCA_SUCCESS,&sender.received,sender.buffer,sender.num,0);
+            processPacket(&sender,VISCA_SUCCESS);
+        }
+    }
+}
+
+/* Check if a command can be sent to a camera. Only one command waits for its
+ * ACK (or the reply of an inquiry) at once, a reply missing for PACE_TIMEOUT
+ * is counted as congestion. Commands are admitted while less than `limit`
+ * sockets are in use, inquiries don't need a socket.
+ */
+static bool isAdmitted ( int address, int cmd, const struct timeval *now )
+{
+    T_Camera *cam = &cameras[address];
+    T_Pace *p = &Pace[address];
+    int i, open = 0;
+
+    if ( p->limit < 1.0 )
+        p->limit = (cam->version && cam->sockets >= 1 && cam->sockets <= VISCA_SOCKETS) ? cam->sockets : VISCA_SOCKETS;
+    if ( cam->track.pending.active )
+    {
+        if ( timeDiff(&cam->track.pending.sent,now) < PACE_TIMEOUT )
+            return false;
+        paceFeedback(address,&cam->track.pending,now,"no reply");
+    }
+    if ( isInquiry(cmd) )
+        return true;
+    for ( i=1; i<=VISCA_SOCKETS; i++ )
+        if ( cam->track.socket[i].active && timeDiff(&cam->track.socket[i].sent,now) < PACE_STUCK )
+            open++;
+    return open < (int)p->limit;
+}
+
+/* Adjust the limit of open commands of a camera (AIMD). Each reply adds
+ * PACE_INCREASE/limit, so the limit grows by PACE_INCREASE per round trip.
+ * On `congestion` the limit is halved, once per round trip: only replies of
+ * commands sent after the last halving count. The latency of the ACK (or the
+ * reply of an inquiry) is checked against the ceiling as p99 of the replies
+ * since the last halving. A change of the whole number is logged as span.
+ */
+static void paceFeedback ( int address, const T_Transaction *t, const struct timeval *end, const char *congestion )
+{
+    T_Camera *cam = &cameras[address];
+    T_Pace *p = &Pace[address];
+    char reason[32];
+    double max;
+    int old;
+
+    if ( PaceCeiling <= 0 )
+        return;
+    max = (cam->version && cam->sockets >= 1 && cam->sockets <= VISCA_SOCKETS) ? cam->sockets : VISCA_SOCKETS;
+    if ( p->limit < 1.0 )
+        p->limit = max;
+    old = (int)p->limit;
+    if ( !congestion )
+    {
+        histAdd(&p->latency,timeDiff(&t->sent,end));
+        if ( p->latency.cnt >= PACE_SAMPLES && histPercentile(&p->latency,99) > PaceCeiling )
+        {
+            snprintf(reason,sizeof(reason),"p99 %ld ms",histPercentile(&p->latency,99));
+            congestion = reason;
+        }
+        else
+        {
+            if ( p->latency.cnt >= PACE_WINDOW )
+                memset(&p->latency,0,sizeof(p->latency));
+            p->limit += PACE_INCREASE / p->limit;
+            if ( p->limit > max )
+                p->limit = max;
+        }
+    }
+    if ( congestion )
+    {
+        if ( timercmp(&t->sent,&p->decreased,<) )
+            return;
+        p->limit /= 2.0;
+        if ( p->limit < 1.0 )
+            p->limit = 1.0;
+        p->decreased = *end;
+        p->decreases++;
+        memset(&p->latency,0,sizeof(p->latency));
+    }
+    if ( p->low == 0 || p->limit*100.0 < p->low )
+        p->low = (uint16_t)(p->limit*100.0);
+    if ( (int)p->limit != old )
+        printf("%s SPN: pace          cam%d  limit %d -> %d (%s)\n",
+               logTime(end,false),address,old,(int)p->limit,congestion?congestion:"increase");
+}
+
+/* Dump the pacing of each camera.
+ */
+static void dumpPace ( void )
+{
+    T_Pace *p;
+    int i;
+
+    for ( i=1; i<=VISCA_MAX_CAMERAS; i++ )
+    {
+        p = &Pace[i];
+        if ( p->limit < 1.0 )
+            continue;
+        printf("~~~~~~~~~~~~~~~~~~~ pace cam%d: limit=%.2f (ceiling %ld ms) | decreases=%ld | held=%ld rejected=%ld queued=%u | wait p50/p90/p99=%ld/%ld/%ld [ms]\n",
+               i,p->limit,PaceCeiling,p->decreases,p->held,p->rejected,p->head-p->tail,
+               histPercentile(&p->wait,50),histPercentile(&p->wait,90),histPercentile(&p->wait,99));
+    }
+}
+
+/* Parse a service level objective `class[@cam]:ack|done:pNN<ms`. The class
+ * is `all`, `cmd` (no inquiries), `inq`, `stop` or the name of a command.
+ */
+static bool parseSlo ( const char *spec )
+{
+    T_Slo *slo = &Slo[SloCount];
+    char name[24];
+    const char *p;
+    char *end;
+    size_t len;
+    int i;
+
+    if ( SloCount >= SLO_MAX || strlen(spec) >= sizeof(slo->spec) )
+        return false;
+    memset(slo,0,sizeof(T_Slo));
+    len = strcspn(spec,"@:");
+    if ( len == 0 || len >= sizeof(name) )
+        return false;
+    memcpy(name,spec,len);
+    name[len] = '\0';
+    for ( i=SLO_All; i<SLO_MAX_CLASSES; i++ )
+        if ( strcmp(name,SloClassNames[i]) == 0 )
+            break;
+    slo->cls = (i < SLO_MAX_CLASSES) ? i : SLO_Command;
+    if ( slo->cls == SLO_Command )
+    {
+        for ( i=1; i<RPL_Address; i++ )
+            if ( strncmp(SequenceNames[i],"CMD: ",5) == 0 && strcmp(SequenceNames[i]+5,name) == 0 )
+                break;
+        if ( i >= RPL_Address )
+            return false;
+        slo->cmd = i;
+    }
+    p = spec+len;
+    if ( *p == '@' )
+    {
+        slo->address = (int)strtol(p+1,&end,10);
+        if ( end == p+1 || slo->address < 1 || slo->address > VISCA_MAX_CAMERAS )
+            return false;
+        p = end;
+    }
+    if ( strncmp(p,":ack:p",6) == 0 )
+    {
+        slo->ack = true;
+        p += 6;
+    }
+    else if ( strncmp(p,":done:p",7) == 0 )
+        p += 7;
+    else
+        return false;
+    slo->objective = strtod(p,&end)/100.0;
+    if ( end == p || *end != '<' || slo->objective <= 0.0 || slo->objective >= 1.0 )
+        return false;
+    p = end+1;
+    slo->threshold = strtol(p,&end,10);
+    if ( end == p || *end != '\0' || slo->threshold <= 0 )
+        return false;
+    slo->good = calloc(SLO_RING,sizeof(uint32_t));
+    slo->total = calloc(SLO_RING,sizeof(uint32_t));
+    if ( !slo->good || !slo->total )
+        return false;
+    strcpy(slo->spec,spec);
+    slo->id = (uint32_t)hashFNV(FNV_OFFSET,spec,strlen(spec));
+    if ( slo->id == 0 )
+        slo->id = 1;
+    SloCount++;
+    return true;
+}
+
+/* Return true if the transaction `t` of camera `address` belongs to `slo`.
+ */
+static bool matchSlo ( const T_Slo *slo, int address, const T_Transaction *t )
+{
+    if ( slo->address != 0 && slo->address != address )
+        return false;
+    switch ( slo->cls )
+    {
+        case SLO_All:
+            return true;
+        case SLO_Commands:
+            return !isInquiry(t->cmd);
+        case SLO_Inquiries:
+            return isInquiry(t->cmd);
+        case SLO_Stops:
+            return isStop(t);
+        default:
+            return t->cmd == slo->cmd;
+    }
+}
+
+/* A stop of Zoom, Focus or EXT_Turn.
+ */
+static bool isStop ( const T_Transaction *t )
+{
+    return (t->cmd == CMD_Zoom || t->cmd == CMD_Focus || t->cmd == CMD_EXT_Turn) && t->param == 0;
+}
+
+/* Count a finished transaction in the objectives. An inquiry has no ACK, its
+ * reply counts for `ack` too. A transaction failed before the ACK is bad.
+ */
+static void countSlo ( int address, const T_Transaction *t, const struct timeval *end, bool failed )
+{
+    T_IntervalSlo *c;
+    int i;
+
+    for ( i=0; i<SloCount; i++ )
+    {
+        if ( !matchSlo(&Slo[i],address,t) )
+            continue;
+        c = &Interval.slo[i];
+        c->id = Slo[i].id;
+        c->total++;
+        if ( isGoodSlo(&Slo[i],t,end,failed) )
+            c->good++;
+    }
+}
+
+/* A transaction is good for an objective if it got the ACK (`ack`) or was
+ * completed within the threshold. A transaction without any reply (`end` is
+ * NULL) is bad.
+ */
+static bool isGoodSlo ( const T_Slo *slo, const T_Transaction *t, const struct timeval *end, bool failed )
+{
+    if ( !end )
+        return false;
+    if ( slo->ack && t->acked.tv_sec )
+        return timeDiff(&t->sent,&t->acked) <= slo->threshold;
+    return !failed && timeDiff(&t->sent,end) <= slo->threshold;
+}
+
+/* Push a finished interval into the rings of the objectives. Each interval
+ * (the empty ones in between too) adds to the sums of the windows and
+ * removes the interval falling out of each window. A gap longer than the
+ * ring clears it.
+ */
+static void pushSlo ( const T_Interval *interval )
+{
+    T_Slo *slo;
+    int64_t steps;
+    uint32_t idx, old, good, total;
+    int i, w;
+
+    for ( i=0; i<SloCount; i++ )
+    {
+        slo = &Slo[i];
+        steps = slo->last ? (interval->start - slo->last) / INTERVAL_LENGTH : 1;
+        if ( steps <= 0 )
+            continue;                   // (a replay going back)
+        if ( steps > SLO_RING )
+        {
+            memset(slo->good,0,SLO_RING*sizeof(uint32_t));
+            memset(slo->total,0,SLO_RING*sizeof(uint32_t));
+            memset(slo->sum_good,0,sizeof(slo->sum_good));
+            memset(slo->sum_total,0,sizeof(slo->sum_total));
+            slo->head = 0;
+            steps = 1;
+        }
+        for ( ; steps>0; steps-- )
+        {
+            good = (steps == 1) ? interval->slo[i].good : 0;
+            total = (steps == 1) ? interval->slo[i].total : 0;
+            idx = slo->head % SLO_RING;
+            for ( w=0; w<SLO_WINDOWS; w++ )
+            {
+                if ( slo->head < SloWindow[w]/INTERVAL_LENGTH )
+                    continue;
+                old = (slo->head - SloWindow[w]/INTERVAL_LENGTH) % SLO_RING;
+                slo->sum_good[w] -= slo->good[old];
+                slo->sum_total[w] -= slo->total[old];
+            }
+            slo->good[idx] = good;
+            slo->total[idx] = total;
+            for ( w=0; w<SLO_WINDOWS; w++ )
+            {
+                slo->sum_good[w] += good;
+                slo->sum_total[w] += total;
+            }
+            slo->head++;
+        }
+        slo->last = interval->start;
+
+        // multi window alert: the 5m and the 1h window burn fast
+        if ( (burnSlo(slo->sum_good[0],slo->sum_total[0],slo->objective) > SLO_FAST_BURN
+              && burnSlo(slo->sum_good[1],slo->sum_total[1],slo->objective) > SLO_FAST_BURN) != slo->alert )
+        {
+            struct timeval tick = { (time_t)interval->start+INTERVAL_LENGTH, 0 };
+
+            slo->alert = !slo->alert;
+            if ( !Quiet )
+                printf("%s SPN: slo           %s burn 5m=%.1f 1h=%.1f budget=%.1f%% (%s)\n",
+                       logTime(&tick,false),slo->spec,
+                       burnSlo(slo->sum_good[0],slo->sum_total[0],slo->objective),
+                       burnSlo(slo->sum_good[1],slo->sum_total[1],slo->objective),
+                       100.0*(1.0-burnSlo(slo->sum_good[2],slo->sum_total[2],slo->objective)),
+                       slo->alert?"alert":"ok");
+        }
+    }
+}
+
+/* The burn rate: the share of bad transactions relative to the error
+ * budget. 1.0 uses up the budget exactly within the window.
+ */
+static double burnSlo ( uint64_t good, uint64_t total, double objective )
+{
+    if ( total == 0 )
+        return 0.0;
+    return (double)(total-good) / (double)total / (1.0-objective);
+}
+
+/* Dump the burn rates of the windows and the error budget left of the
+ * longest window.
+ */
+static void dumpSlo ( void )
+{
+    const T_Slo *slo;
+    int i, w;
+
+    for ( i=0; i<SloCount; i++ )
+    {
+        slo = &Slo[i];
+        printf("~~~~~~~~~~~~~~~~~~~ slo %s: n=%llu bad=%llu | burn",slo->spec,
+               (unsigned long long)slo->sum_total[SLO_WINDOWS-1],
+               (unsigned long long)(slo->sum_total[SLO_WINDOWS-1]-slo->sum_good[SLO_WINDOWS-1]));
+        for ( w=0; w<SLO_WINDOWS; w++ )
+            printf(" %s=%.2f",SloWindowNames[w],burnSlo(slo->sum_good[w],slo->sum_total[w],slo->objective));
+        printf(" | budget left %.1f%%%s\n",
+               100.0*(1.0-burnSlo(slo->sum_good[SLO_WINDOWS-1],slo->sum_total[SLO_WINDOWS-1],slo->objective)),
+               slo->alert?" ALERT":"");
+    }
+}
+
+/* The objectives for a query of the store: the range and the windows before
+ * `now`. The objectives are identified by their definition, so the same `-O`
+ * must be given as for the recording.
+ */
+static void querySlo ( int64_t now, long range )
+{
+    const T_Slo *slo;
+    uint64_t good, total;
+    int i, w;
+
+    for ( i=0; i<SloCount; i++ )
+    {
+        slo = &Slo[i];
+        sumStore(slo->id,now-range,now,&good,&total);
+        printf("~~~~~~~~~~~~~~~~~~~ slo %s: n=%llu bad=%llu burn=%.2f budget left %.1f%% | burn",slo->spec,
+               (unsigned long long)total,(unsigned long long)(total-good),
+               burnSlo(good,total,slo->objective),100.0*(1.0-burnSlo(good,total,slo->objective)));
+        for ( w=0; w<SLO_WINDOWS; w++ )
+        {
+            sumStore(slo->id,now-SloWindow[w],now,&good,&total);
+            printf(" %s=%.2f",SloWindowNames[w],burnSlo(good,total,slo->objective));
+        }
+        printf("\n");
+    }
+}
+
+/* Sum the counters of the objective `id` in the store, using the finest
+ * level holding the range.
+ */
+static void sumStore ( uint32_t id, int64_t from, int64_t to, uint64_t *good, uint64_t *total )
+{
+    const T_RrdHeader *hdr = (const T_RrdHeader *)Rrd;
+    const T_Interval *slot;
+    int64_t start;
+    int i, level;
+
+    *good = *total = 0;
+    for ( level=0; level<RRD_LEVELS-1; level++ )
+        if ( (int64_t)hdr->level[level].step*hdr->level[level].slots >= to-from )
+            break;
+    from -= from % hdr->level[level].step;
+    for ( start=from; start<=to; start+=hdr->level[level].step )
+    {
+        slot = (const T_Interval *)(Rrd + hdr->level[level].offset)
+               + (start / hdr->level[level].step) % hdr->level[level].slots;
+        if ( slot->start != start )
+            continue;
+        for ( i=0; i<SLO_MAX; i++ )
+        {
+            if ( slot->slo[i].id != id )
+                continue;
+            *good += slot->slo[i].good;
+            *total += slot->slo[i].total;
+        }
+    }
+}
+
+/* Setup the serial interfaces using the ezV24 library.
+ */
+static bool setupInterface ( T_VISCAInterface *intf, const char *PortName, const char *IntfName )
+{
+    int rc;
+
+    if ( intf==NULL  || PortName==NULL )
+    {
+        fputs("ERROR: setupInterface(): invalid parameter!\n", stderr);
+        return false;
+    }
+
+    /* First we have to open the port.
+     */
+    intf->uart = v24OpenPort(PortName,MyOpenFlags);
+    if ( intf->uart == NULL )
+    {
+        fputs("ERROR: sorry, open failed!\n", stderr);
+        return false;
+    }
+    fprintf(stderr,"INFO: port '%s' opened!\n",PortName);
+    intf->timedout = false;
+    intf->valid = false;
+    intf->unknown = 0;
+    intf->cnt = 0;
+
+    /* than we have to configure the port.
+     */
+    rc = v24SetParameters(intf->uart, V24_B9600, V24_8BIT, V24_NONE);
+    if ( rc != V24_E_OK )
+    {
+        dumpErrorMessage(rc);
+        v24ClosePort(intf->uart);
+        intf->uart = NULL;
+        return false;
+    }
+    if ( MyTimeOut > 0 )
+    {
+        rc=v24SetTimeouts(intf->uart,MyTimeOut*10);
+        if ( rc==V24_E_NOT_IMPLEMENTED )
+            fputs("INFO: setup of timeout is not available!\n",stderr);
+        else if ( rc!=V24_E_OK )
+        {
+            dumpErrorMessage(rc);
+            v24ClosePort(intf->uart);
+            intf->uart = NULL;
+            return false;
+        }
+        else
+            fprintf(stderr,"INFO: timeout is set to %dsec\n",MyTimeOut);
+    }
+
+    /* remember the name of the interface
+     */
+    if ( IntfName )
+    {
+        strncpy(intf->name,IntfName,SZ_INTERFACE_NAME);
+        intf->name[SZ_INTERFACE_NAME] = '\0';
+    }
+    else
+        intf->name[0] = '\0';
+    return true;
+}
+
+/* return a timestamp as string. The returned pointer references a static
+ * buffer, so the next call to this functions modifies the content!
+ */
+static const char *logTime ( const struct timeval *tick, bool full )
+{
+    static char time_str[50];
+    struct tm *t;
+
+    t = localtime(&(tick->tv_sec));
+    if ( t )
+    {
+        if ( full )
+        {
+            snprintf(time_str,sizeof(time_str),
+                     "%2.2d.%2.2d.%4.4d %2.2d:%2.2d:%2.2d[%4.4d]",
+                     t->tm_mday,t->tm_mon,t->tm_year+1900,
+                     t->tm_hour,t->tm_min,t->tm_sec,
+                     (int)(tick->tv_usec/1000));
+            time_str[sizeof(time_str)-1]='\0';
+        }
+        else
+        {
+            snprintf(time_str,sizeof(time_str),
+                     "%2.2d:%2.2d:%2.2d[%4.4d]",
+                     t->tm_hour,t->tm_min,t->tm_sec,
+                     (int)(tick->tv_usec/1000));
+            time_str[sizeof(time_str)-1]='\0';
+        }
+    }
+    else
+    {
+        strcpy(time_str,"NULL");
+    }
+    return time_str;
+}
+
+/* return only the [ms] as string. The returned pointer references a static
+ * buffer, so the next call to this functions modifies the content!
+ */
+static const char *milliSeconds ( const struct timeval *tick )
+{
+    static char time_str[50];
+
+    if ( tick )
+    {
+        snprintf(time_str,sizeof(time_str)-1,
+                 "[%4.4d]",(int)(tick->tv_usec/1000));
+        time_str[sizeof(time_str)-1]='\0';
+    }
+    else
+    {
+        strcpy(time_str,"[----]");
+    }
+    return time_str;
+}
+
+/* Calculate difference in timestamps and add this to an avarage value. The
+ * difference is returned.
+ */
+static long int addToAvarage ( const struct timeval *from, const struct timeval *to, T_Avarage *avg )
+{
+    long int diff;
+
+    if ( !from || !to || !avg )
+    {
+        fputs("error: addToAvarage(): NULL parameter\n", stderr);
+        return 0.0;
+    }
+    if ( from->tv_sec > to->tv_sec )
+    {
+        fputs("error: addToAvarage(): 'from' later than 'to'\n", stderr);
+        return 0.0;
+    }
+    diff = (long int)(to->tv_sec-from->tv_sec)*1000L+(long int)(to->tv_usec-from->tv_usec)/1000L;
+    if ( diff < AVG_OUTLIER )
+    {
+        avg->sum += (long double)diff;
+        avg->cnt++;
+        avg->current = avg->sum/avg->cnt;
+    }
+    else
+    {
+        fputs("error: addToAvarage(): skip outlier\n", stderr);
+    }
+    return diff;
+}
+
+/* Return the seconds since `from`.
+ */
+static double benchTime ( const struct timespec *from )
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    return (double)(now.tv_sec-from->tv_sec) + (double)(now.tv_nsec-from->tv_nsec)/1e9;
+}
+
+/* Run the benchmarks. No serial port is used.
+ *
+ * - decode: classify BENCH_FRAMES random packets (built from the known
+ *   sequences) with findCommand() one by one and with findCommands().
+ */
+static void runBenchmarks ( void )
+{
+    uint8_t *data;
+    uint32_t *offset;
+    uint8_t *length;
+    int16_t *cmd;
+    uint8_t *address, *socket;
+    uint32_t *param;
+    struct timespec start;
+    double single, batch;
+    size_t size = 0;
+    long sum = 0;
+    int i, errors = 0;
+
+    data = malloc((size_t)BENCH_FRAMES*VISCA_MAX_SIZE);
+    offset = malloc(BENCH_FRAMES*sizeof(uint32_t));
+    length = malloc(BENCH_FRAMES);
+    cmd = malloc(BENCH_FRAMES*sizeof(int16_t));
+    address = malloc(BENCH_FRAMES);
+    socket = malloc(BENCH_FRAMES);
+    param = malloc(BENCH_FRAMES*sizeof(uint32_t));
+    if ( !data || !offset || !length || !cmd || !address || !socket || !param )
+    {
+        fputs("ERROR: runBenchmarks(): out of memory\n",stderr);
+        exit(1);
+    }
+
+    size = benchPackets(data,offset,length,BENCH_FRAMES);
+
+    clock_gettime(CLOCK_MONOTONIC,&start);
+    for ( i=0; i<BENCH_FRAMES; i++ )
+        sum += findCommand(data+offset[i],length[i]);
+    single = benchTime(&start);
+
+    clock_gettime(CLOCK_MONOTONIC,&start);
+    findCommands(data,size,offset,length,BENCH_FRAMES,cmd,address,socket,param);
+    batch = benchTime(&start);
+
+    for ( i=0; i<BENCH_FRAMES; i++ )
+        if ( cmd[i] != findCommand(data+offset[i],length[i]) )
+            errors++;
+    printf("decode: %d packets | findCommand %.1f ns/pkt | findCommands %.1f ns/pkt | speedup %.1f | mismatch=%d (%ld)\n",
+           BENCH_FRAMES,single*1e9/BENCH_FRAMES,batch*1e9/BENCH_FRAMES,single/batch,errors,sum);
+
+    free(data); free(offset); free(length); free(cmd);
+    free(address); free(socket); free(param);
+
+    benchCapture(false);
+    benchCapture(true);
+    benchFramer();
+    benchReactor(true);
+    benchReactor(false);
+    benchClock();
+    benchRender();
+    benchHints();
+}
+
+/* The latency hints: the cost of publishHint() and of a read of a record,
+ * without and with a writer thread changing the record all the time. Each
+ * record of the writer holds a single counter in all the fields, so a torn
+ * read is found.
+ */
+static void benchHints ( void )
+{
+    T_HintTable *table;
+    T_HintCamera v;
+    struct timespec start;
+    struct timeval now;
+    pthread_t writer;
+    double publish, idle, busy;
+    long retries = 0, torn = 0, failed = 0, sum = 0;
+    int i, c, n;
+
+    table = mmap(NULL,sizeof(T_HintTable),PROT_READ|PROT_WRITE,MAP_SHARED|MAP_ANONYMOUS,-1,0);
+    if ( table == MAP_FAILED )
+    {
+        fputs("ERROR: benchHints(): mmap failed\n",stderr);
+        exit(1);
+    }
+    table->pid = (uint32_t)getpid();
+    Hints = table;
+    for ( i=0; i<1000; i++ )
+    {
+        addHint(&HintAck[1][i % HINT_MAX_CLASSES],40+i%13);
+        addHint(&HintDone[1][i % HINT_MAX_CLASSES],300+i%97);
+        HintFailed[1][HintCount[1]++ % HINT_WINDOW] = (i % 50 == 0);
+    }
+    getTime(&now);
+    clock_gettime(CLOCK_MONOTONIC,&start);
+    for ( i=0; i<BENCH_HINTS/10; i++ )
+        publishHint(1,&now);
+    publish = benchTime(&start);
+    Hints = NULL;
+
+    clock_gettime(CLOCK_MONOTONIC,&start);
+    for ( i=0; i<BENCH_HINTS; i++ )
+    {
+        n = readHint(table,1,&v);
+        if ( n < 0 )
+            failed++;
+        else
+            retries += n;
+        sum += v.ack_p50[i % HINT_MAX_CLASSES];
+    }
+    idle = benchTime(&start);
+
+    atomic_store(&HintBenchStop,false);
+    if ( pthread_create(&writer,NULL,benchHintWriter,table) != 0 )
+    {
+        fputs("ERROR: benchHints(): no writer thread\n",stderr);
+        exit(1);
+    }
+    while ( atomic_load(&table->cam[2].seq) < 2 )
+        ;
+    clock_gettime(CLOCK_MONOTONIC,&start);
+    for ( i=0; i<BENCH_HINTS; i++ )
+    {
+        n = readHint(table,2,&v);
+        if ( n < 0 )
+        {
+            failed++;
+            continue;
+        }
+        retries += n;
+        for ( c=0; c<HINT_MAX_CLASSES; c++ )
+            if ( v.ack_p50[c] != (uint16_t)v.transactions || v.done_p99[c] != (uint16_t)v.transactions )
+                break;
+        if ( c < HINT_MAX_CLASSES || v.updated != (int64_t)v.transactions )
+            torn++;
+    }
+    busy = benchTime(&start);
+    atomic_store(&HintBenchStop,true);
+    pthread_join(writer,NULL);
+
+    printf("hints: %d reads | publish %.1f ns | read %.1f ns | contended %.1f ns | %u writes | retries=%ld torn=%ld failed=%ld (%ld)\n",
+           BENCH_HINTS,publish*1e9/(BENCH_HINTS/10),idle*1e9/BENCH_HINTS,busy*1e9/BENCH_HINTS,
+           atomic_load(&table->cam[2].seq)/2,retries,torn,failed,sum);
+    munmap(table,sizeof(T_HintTable));
+}
+
+/* Write the record of camera 2 until HintBenchStop.
+ */
+static void *benchHintWriter ( void *arg )
+{
+    T_HintTable *table = arg;
+    T_HintCamera v;
+    uint32_t n;
+    int c;
+
+    memset(&v,0,sizeof(v));
+    for ( n=1; !atomic_load_explicit(&HintBenchStop,memory_order_relaxed); n++ )
+    {
+        for ( c=0; c<HINT_MAX_CLASSES; c++ )
+            v.ack_p50[c] = v.ack_p99[c] = v.done_p50[c] = v.done_p99[c] = (uint16_t)n;
+        v.sockets = v.busy = (uint8_t)n;
+        v.errors = (uint16_t)n;
+        v.transactions = n;
+        v.updated = n;
+        writeHint(&table->cam[2],&v);
+    }
+    return NULL;
+}
+
+/* The cost of a timestamp by gettimeofday(), clock_gettime() and the TSC,
+ * and the drift of the TSC against CLOCK_MONOTONIC without recalibration.
+ */
+static void benchClock ( void )
+{
+    struct timespec start, now, pause = { 0, 100000000L };
+    struct timeval tick;
+    double gtod, mono, tsc = 0.0, drift = 0.0, err;
+    uint64_t t;
+    int64_t m, r;
+    long sum = 0;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC,&start);
+    for ( i=0; i<BENCH_CLOCKS; i++ )
+    {
+        gettimeofday(&tick,NULL);
+        sum += tick.tv_usec;
+    }
+    gtod = benchTime(&start);
+    clock_gettime(CLOCK_MONOTONIC,&start);
+    for ( i=0; i<BENCH_CLOCKS; i++ )
+    {
+        clock_gettime(CLOCK_MONOTONIC,&now);
+        sum += now.tv_nsec;
+    }
+    mono = benchTime(&start);
+    if ( initTsc() )
+    {
+        clock_gettime(CLOCK_MONOTONIC,&start);
+        for ( i=0; i<BENCH_CLOCKS; i++ )
+        {
+            getTime(&tick);
+            sum += tick.tv_usec;
+        }
+        tsc = benchTime(&start);
+
+        // the TSC predicts CLOCK_MONOTONIC, without recalibration
+        for ( i=0; i<BENCH_DRIFT*10; i++ )
+        {
+            nanosleep(&pause,NULL);
+            if ( !readTscPair(&t,&m,&r) )
+                continue;
+            err = fabs(Tsc.mono + (double)(t-Tsc.tsc) * Tsc.ns_per_tick - m);
+            if ( err > drift )
+                drift = err;
+        }
+    }
+    printf("clock: %d timestamps | gettimeofday %.1f ns | clock_gettime %.1f ns | tsc ",
+           BENCH_CLOCKS,gtod*1e9/BENCH_CLOCKS,mono*1e9/BENCH_CLOCKS);
+    if ( Tsc.valid )
+        printf("%.1f ns | drift max %.2f [us] in %d s (%.2f ppm) (%ld)\n",
+               tsc*1e9/BENCH_CLOCKS,drift/1000.0,BENCH_DRIFT,drift/(BENCH_DRIFT*1000.0),sum%10);
+    else
+        printf("unsuitable (%ld)\n",sum%10);
+    Tsc.valid = false;
+}
+
+/* Render BENCH_RENDER packets to /dev/null by the hardcoded formatter of the
+ * older versions (printf) and by the plan of the default template, and by a
+ * minimal template. The lines of the formatter and the plan are compared.
+ */
+static void benchRender ( void )
+{
+    T_VISCAInterface intf;
+    T_RenderPlan minimal;
+    uint8_t *data, *length;
+    uint32_t *offset;
+    char line[RENDER_LINE], legacy[RENDER_LINE];
+    struct timespec start;
+    double format, plan, little;
+    FILE *null, *mem;
+    long int diff;
+    size_t len;
+    int i, errors = 0;
+
+    data = malloc((size_t)BENCH_RENDER*VISCA_MAX_SIZE);
+    offset = malloc(BENCH_RENDER*sizeof(uint32_t));
+    length = malloc(BENCH_RENDER);
+    null = fopen("/dev/null","w");
+    mem = fmemopen(legacy,sizeof(legacy),"w");
+    if ( !data || !offset || !length || !null || !mem )
+    {
+        fputs("ERROR: benchRender(): out of memory\n",stderr);
+        exit(1);
+    }
+    benchPackets(data,offset,length,BENCH_RENDER);
+    memset(&intf,0,sizeof(intf));
+    compileTemplate(&minimal,"%e %n %x");
+
+    clock_gettime(CLOCK_MONOTONIC,&start);
+    for ( i=0; i<BENCH_RENDER; i++ )
+    {
+        diff = benchLine(&intf,data,offset,length,i);
+        benchFormat(null,&intf,diff);
+    }
+    fflush(null);
+    format = benchTime(&start);
+
+    clock_gettime(CLOCK_MONOTONIC,&start);
+    for ( i=0; i<BENCH_RENDER; i++ )
+    {
+        diff = benchLine(&intf,data,offset,length,i);
+        len = renderPacket(&Render,line,&intf,diff);
+        fwrite(line,1,len,null);
+    }
+    fflush(null);
+    plan = benchTime(&start);
+
+    clock_gettime(CLOCK_MONOTONIC,&start);
+    for ( i=0; i<BENCH_RENDER; i++ )
+    {
+        diff = benchLine(&intf,data,offset,length,i);
+        len = renderPacket(&minimal,line,&intf,diff);
+        fwrite(line,1,len,null);
+    }
+    fflush(null);
+    little = benchTime(&start);
+
+    for ( i=0; i<BENCH_RENDER; i++ )
+    {
+        diff = benchLine(&intf,data,offset,length,i);
+        len = renderPacket(&Render,line,&intf,diff);
+        rewind(mem);
+        benchFormat(mem,&intf,diff);
+        fflush(mem);
+        if ( (size_t)ftell(mem) != len || memcmp(line,legacy,len) != 0 )
+            errors++;
+    }
+    printf("render: %d packets | printf %.1f ns/pkt | plan %.1f ns/pkt | speedup %.1f | minimal %.1f ns/pkt | mismatch=%d\n",
+           BENCH_RENDER,format*1e9/BENCH_RENDER,plan*1e9/BENCH_RENDER,format/plan,little*1e9/BENCH_RENDER,errors);
+
+    fclose(mem);
+    fclose(null);
+    free(data); free(offset); free(length);
+}
+
+/* Load the packet `i` of benchPackets() into `interface`, a packet each
+ * 1.042ms. Half of the replies get a reply time, the avarages vary. Returns
+ * the reply time.
+ */
+static long int benchLine ( T_VISCAInterface *interface, const uint8_t *data, const uint32_t *offset,
+                            const uint8_t *length, int i )
+{
+    const uint8_t *b = data+offset[i];
+
+    interface->num = (length[i] < VISCA_MAX_SIZE) ? length[i] : VISCA_MAX_SIZE;
+    memcpy(interface->buffer,b,interface->num);
+    interface->type = b[1] & 0xF0;
+    interface->received.tv_sec = 1700000000L + (long)i*1042/1000000;
+    interface->received.tv_usec = (long)i*1042%1000000;
+    interface->cmd = findCommand(b,(uint8_t)interface->num);
+    interface->valid = true;
+    strcpy(interface->name,(b[0] >= 0x90) ? "CAM" : "CTL");
+    if ( b[0] < 0x90 || !(i & 1) )
+        return 0L;
+    avg_ack.current = 5.0L + (i % 4099) / 64.0L;
+    avg_done.current = 20.0L + (i % 8191) / 3.0L;
+    return 1 + i % 2000;
+}
+
+/* The formatter of the older versions, the baseline of benchRender().
+ */
+static void benchFormat ( FILE *out, const T_VISCAInterface *interface, long int diff )
+{
+    long double avg;
+    char type;
+    int i;
+
+    fprintf(out,"%s %3.3s: ",logTime(&(interface->received),false),interface->name);
+    for ( i=0; i<VISCA_MAX_SIZE; i++ )
+    {
+        if ( i < interface->num )
+            fprintf(out,"%2.2X ",interface->buffer[i]);
+        else
+            fprintf(out,"   ");
+    }
+    if ( interface->type==VISCA_TYPE_RESPONSE_ACK )
+    {
+        avg = avg_ack.current;
+        type = 'A';
+    }
+    else
+    {
+        avg = avg_done.current;
+        type = 'D';
+    }
+
+    if ( diff )
+        fprintf(out,"{%4.4ld/%6.2Lf%c} ",diff,avg,type);
+    else
+        fprintf(out,"{    /       } ");
+    fprintf(out," - %s\n",SequenceNames[interface->cmd]);
+}
+
+/* Emulate two lines over ptys: the CTL line busy (BENCH_CTL_BURST packets
+ * back to back, then one idle), a CAM packet each BENCH_CAM_PERIOD. Measure
+ * the delay from the last byte of a CAM packet until it is handled, and the
+ * CPU time of the reading thread. The `legacy` loop polls both ports with
+ * v24HaveData() and reads a whole packet with getViscaPacket(), so a CAM
+ * packet waits for the rest of a CTL packet. pollPorts() reads what's there.
+ * On an error, all ports and ptys opened so far are closed.
+ */
+static void benchReactor ( bool legacy )
+{
+    static T_BenchReactor lines;
+    T_VISCAInterface ctl, cam;
+    T_VISCAInterface *ports[MAX_LINES] = { &ctl, &cam };
+    char ctl_name[64], cam_name[64];
+    int ctl_slave = -1, cam_slave = -1;
+    struct timespec c0, c1, start;
+    struct termios raw;
+    pthread_t writer;
+    double cpu, wall;
+    bool running = false;
+
+    memset(&lines,0,sizeof(lines));
+    memset(&ctl,0,sizeof(ctl));
+    memset(&cam,0,sizeof(cam));
+    memset(&raw,0,sizeof(raw));
+    lines.ctl = lines.cam = -1;
+    cfmakeraw(&raw);
+    if ( openpty(&lines.ctl,&ctl_slave,ctl_name,&raw,NULL) < 0
+         || openpty(&lines.cam,&cam_slave,cam_name,&raw,NULL) < 0 )
+        fputs("ERROR: benchReactor(): no pty\n",stderr);
+    else if ( setupInterface(&ctl,ctl_name,"CTL") && setupInterface(&cam,cam_name,"CAM") )
+    {
+        close(ctl_slave);
+        close(cam_slave);
+        ctl_slave = cam_slave = -1;
+        BenchLines = &lines;
+        atomic_store(&lines.stop,false);
+        clock_gettime(CLOCK_MONOTONIC,&start);
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID,&c0);
+        running = (pthread_create(&writer,NULL,benchWriter,&lines) == 0);
+        if ( !running )
+            fputs("ERROR: benchReactor(): can't start the writer\n",stderr);
+    }
+    while ( running && !atomic_load(&lines.stop) )
+    {
+        if ( legacy )
+        {
+            if ( v24HaveData(ctl.uart) )
+                benchHandle(&ctl,getViscaPacket(&ctl));
+            if ( v24HaveData(cam.uart) )
+                benchHandle(&cam,getViscaPacket(&cam));
+        }
+        else
+            pollPorts(ports,MAX_LINES,benchHandle,REACTOR_TICK);
+    }
+    if ( running )
+    {
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID,&c1);
+        cpu = (c1.tv_sec-c0.tv_sec) + (c1.tv_nsec-c0.tv_nsec)*1e-9;
+        pthread_join(writer,NULL);
+        wall = benchTime(&start);
+        printf("reactor %-6s: %d CAM packets | delay p50/p90/p99=%ld/%ld/%ld max %ld [us] | CTL %ld packets | cpu %.1f%%\n",
+               legacy?"legacy":"poll",lines.handled,
+               histPercentile(&lines.delay,50)*10,histPercentile(&lines.delay,90)*10,histPercentile(&lines.delay,99)*10,
+               lines.max,ctl.cnt,100.0*cpu/wall);
+    }
+    if ( ctl.uart )
+        v24ClosePort(ctl.uart);
+    if ( cam.uart )
+        v24ClosePort(cam.uart);
+    if ( ctl_slave >= 0 )
+        close(ctl_slave);
+    if ( cam_slave >= 0 )
+        close(cam_slave);
+    if ( lines.ctl >= 0 )
+        close(lines.ctl);
+    if ( lines.cam >= 0 )
+        close(lines.cam);
+    BenchLines = NULL;
+}
+
+/* Write the bytes of both lines at 9600 baud.
+ */
+static void *benchWriter ( void *arg )
+{
+    static const uint8_t inquiry[] = { 0x81, 0x09, 0x04, 0x47, 0xFF };
+    static const uint8_t reply[] = { 0x90, 0x50, 0x00, 0x01, 0x02, 0x03, 0xFF };
+    T_BenchReactor *lines = arg;
+    struct timespec next_ctl, next_cam, *next, end;
+    int ctl_pos = 0, cam_pos = 0, burst = 0, packets = 0;
+    bool more = true;
+
+    clock_gettime(CLOCK_MONOTONIC,&next_ctl);
+    next_cam = end = next_ctl;
+    end.tv_sec += BENCH_REACTOR;
+    while ( more || ctl_pos || cam_pos )
+    {
+        next = (next_ctl.tv_sec < next_cam.tv_sec
+                || (next_ctl.tv_sec == next_cam.tv_sec && next_ctl.tv_nsec <= next_cam.tv_nsec)) ? &next_ctl : &next_cam;
+        clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,next,NULL);
+        if ( next->tv_sec > end.tv_sec || (next->tv_sec == end.tv_sec && next->tv_nsec >= end.tv_nsec) )
+            more = false;               // finish the packets
+        if ( next == &next_ctl )
+        {
+            if ( burst < BENCH_CTL_BURST && (more || ctl_pos) )
+            {
+                if ( write(lines->ctl,&inquiry[ctl_pos],1) != 1 )
+                    break;
+                ctl_pos = (ctl_pos+1) % sizeof(inquiry);
+                if ( ctl_pos == 0 )
+                    burst++;
+            }
+            else
+                burst = 0;              // one packet time idle
+            next_ctl.tv_nsec += (burst == 0 ? sizeof(inquiry) : 1) * VISCA_BYTE_TIME * 1000L;
+            if ( burst == 0 && ctl_pos == 0 && !more )
+                next_ctl.tv_sec += 3600;
+        }
+        else
+        {
+            if ( cam_pos == 0 && (!more || packets >= BENCH_CAM_PACKETS) )
+            {
+                next_cam.tv_sec += 3600;
+                continue;
+            }
+            if ( cam_pos == sizeof(reply)-1 )
+                gettimeofday(&lines->written[packets++],NULL);
+            if ( write(lines->cam,&reply[cam_pos],1) != 1 )
+                break;
+            cam_pos = (cam_pos+1) % sizeof(reply);
+            next_cam.tv_nsec += (cam_pos ? VISCA_BYTE_TIME : BENCH_CAM_PERIOD*1000L - (sizeof(reply)-1)*VISCA_BYTE_TIME) * 1000L;
+        }
+        while ( next->tv_nsec >= 1000000000L )
+        {
+            next->tv_nsec -= 1000000000L;
+            next->tv_sec++;
+        }
+    }
+    usleep(100000);                     // the last packets are read
+    atomic_store(&lines->stop,true);
+    return NULL;
+}
+
+/* Handle a packet of the reactor benchmark.
+ */
+static void benchHandle ( T_VISCAInterface *interface, uint8_t rc )
+{
+    T_BenchReactor *lines = BenchLines;
+    struct timeval now;
+    long us;
+
+    if ( rc != VISCA_SUCCESS || strcmp(interface->name,"CAM") != 0 )
+        return;
+    gettimeofday(&now,NULL);
+    us = timeDiffUs(&lines->written[lines->handled++],&now);
+    histAdd(&lines->delay,us/10);
+    if ( us > lines->max )
+        lines->max = us;
+}
 
-    /* remember the name of the interface
-     */
-    if ( IntfName )
+/* Build `n` packets for the benchmarks: a random sequence, header and
+ * parameters. Returns the number of bytes.
+ */
+static size_t benchPackets ( uint8_t *data, uint32_t *offset, uint8_t *length, int n )
+{
+    size_t size = 0;
+    int i, j, k;
+
+    srand(1);
+    for ( i=0; i<n; i++ )
     {
-        strncpy(intf->name,IntfName,SZ_INTERFACE_NAME);
-        intf->name[SZ_INTERFACE_NAME] = '\0';
+        k = rand() % (CMD_MAX_SEQUENCES-1);     // without the empty entry
+        offset[i] = (uint32_t)size;
+        data[size] = (k < RPL_Address-1) ? 0x81 + rand()%7 : 0x90 + 0x10*(rand()%7);
+        for ( j=0; j<sequences[k].length; j++ )
+            data[size+1+j] = (j < sequences[k].comparable) ? sequences[k].seq[j] : rand()%16;
+        data[size+1+j] = VISCA_TERMINATOR;
+        length[i] = sequences[k].length+2;
+        size += length[i];
     }
-    else
-        intf->name[0] = '\0';
-    return true;
+    return size;
 }
 
-/* return a timestamp as string. The returned pointer references a static
- * buffer, so the next call to this functions modifies the content!
+/* Build the stream of the framer benchmark: the packets with faults injected
+ * at `rate` per packet and type. A timeout is -1 in the stream. The intact
+ * packets and the first byte of each damaged packet are listed.
  */
-static const char *logTime ( const struct timeval *tick, bool full )
+static void benchFaults ( T_BenchStream *b, const uint8_t *data, const uint32_t *offset, const uint8_t *length,
+                          const double *rate )
 {
-    static char time_str[50];
-    struct tm *t;
+    int16_t pkt[2*VISCA_MAX_SIZE];
+    int i, j, k, len;
+    bool lead;                          // spurious byte before the packet
 
-    t = localtime(&(tick->tv_sec));
-    if ( t )
+    srand(2);
+    b->n = b->intact = b->faults = 0;
+    for ( i=0; i<BENCH_FRAMES; i++ )
     {
-        if ( full )
+        len = length[i];
+        for ( j=0; j<len; j++ )
+            pkt[j] = data[offset[i]+j];
+        k = 0;                          // faults within the packet
+        lead = false;
+        if ( rand() < rate[FAULT_Flip]*RAND_MAX )
         {
-            snprintf(time_str,sizeof(time_str),
-                     "%2.2d.%2.2d.%4.4d %2.2d:%2.2d:%2.2d[%4.4d]",
-                     t->tm_mday,t->tm_mon,t->tm_year+1900,
-                     t->tm_hour,t->tm_min,t->tm_sec,
-                     (int)(tick->tv_usec/1000));
-            time_str[sizeof(time_str)-1]='\0';
+            j = rand() % len;
+            pkt[j] ^= (int16_t)(1 << (rand() % 8));
+            k++;
         }
-        else
+        if ( rand() < rate[FAULT_Drop]*RAND_MAX )
         {
-            snprintf(time_str,sizeof(time_str),
-                     "%2.2d:%2.2d:%2.2d[%4.4d]",
-                     t->tm_hour,t->tm_min,t->tm_sec,
-                     (int)(tick->tv_usec/1000));
-            time_str[sizeof(time_str)-1]='\0';
+            j = rand() % len;
+            memmove(&pkt[j],&pkt[j+1],(len-j-1)*sizeof(int16_t));
+            len--;
+            k++;
+        }
+        if ( rand() < rate[FAULT_Truncate]*RAND_MAX && len > 1 )
+        {
+            len = 1 + rand() % (len-1);
+            k++;
+        }
+        if ( rand() < rate[FAULT_Spurious]*RAND_MAX )
+        {
+            j = rand() % (len+1);       // 0 is before the packet
+            memmove(&pkt[j+1],&pkt[j],(len-j)*sizeof(int16_t));
+            pkt[j] = (int16_t)(rand() & 0xFF);
+            len++;
+            if ( j > 0 )
+                k++;
+            else
+                lead = true;
+        }
+        if ( rand() < rate[FAULT_Gap]*RAND_MAX && len > 1 )
+        {
+            j = 1 + rand() % (len-1);
+            memmove(&pkt[j+1],&pkt[j],(len-j)*sizeof(int16_t));
+            pkt[j] = -1;
+            len++;
+            k++;
+        }
+        if ( k > 0 || lead )
+            b->fault[b->faults++] = (uint32_t)b->n;
+        if ( k == 0 )
+        {
+            b->start[b->intact] = (uint32_t)(lead ? b->n+1 : b->n);
+            b->end[b->intact] = (uint32_t)(b->n+len-1);
+            b->id[b->intact++] = (uint32_t)i;
         }
+        for ( j=0; j<len; j++ )
+            b->stream[b->n++] = pkt[j];
     }
-    else
+}
+
+/* The framer of the original getViscaPacket(), as the baseline of the framer
+ * benchmark: a packet starts with any byte with bit 7 set and ends with the
+ * terminator only, so a packet which lost its end swallows the next one. The
+ * bytes are taken from `stream` at `*i` instead of the port, the error
+ * messages and the time stamp are left out.
+ */
+static uint8_t benchOriginal ( T_VISCAInterface *interface, const int16_t *stream, size_t n, size_t *i )
+{
+    int pos;
+
+    interface->timedout = false;
+    interface->valid = false;
+
+    /* read first byte, the header
+     */
+    pos = 0;
+    if ( stream[*i] < 0 )
     {
-        strcpy(time_str,"NULL");
+        (*i)++;
+        interface->num = 0;
+        interface->timedout = true;
+        return VISCA_TIMEDOUT;
     }
-    return time_str;
+    interface->buffer[pos] = (uint8_t)stream[(*i)++];
+    if ( !(interface->buffer[pos] & 0x80) )
+    {
+        interface->num = 1;
+        return VISCA_BAD_HEADER;
+    }
+
+    while ( interface->buffer[pos] != VISCA_TERMINATOR )
+    {
+        pos++;
+        if ( pos >= VISCA_MAX_SIZE )
+        {
+            interface->num = pos;
+            return VISCA_OVERFLOW;
+        }
+        if ( *i >= n || stream[*i] < 0 )
+        {
+            (*i)++;
+            interface->num = pos + 1;
+            interface->timedout = true;
+            return VISCA_TIMEDOUT;
+        }
+        interface->buffer[pos] = (uint8_t)stream[(*i)++];
+    }
+    interface->num = pos + 1;
+    if ( interface->num < VISCA_MIN_SIZE )
+        return VISCA_FAILURE;
+    return VISCA_SUCCESS;
 }
 
-/* return only the [ms] as string. The returned pointer references a static
- * buffer, so the next call to this functions modifies the content!
+/* Feed a stream to frameByte(), or to benchOriginal() without `resync`.
+ * Returns the time in [s].
  */
-static const char *milliSeconds ( const struct timeval *tick )
+static double benchFrameBytes ( const int16_t *stream, size_t n, bool resync )
 {
-    static char time_str[50];
+    T_VISCAInterface f;
+    struct timespec t0;
+    size_t i;
 
-    if ( tick )
+    memset(&f,0,sizeof(f));
+    clock_gettime(CLOCK_MONOTONIC,&t0);
+    if ( resync )
     {
-        snprintf(time_str,sizeof(time_str)-1,
-                 "[%4.4d]",(int)(tick->tv_usec/1000));
-        time_str[sizeof(time_str)-1]='\0';
+        for ( i=0; i<n; i++ )
+            (void)frameByte(&f,stream[i]);
     }
     else
     {
-        strcpy(time_str,"[----]");
+        for ( i=0; i<n; )
+            (void)benchOriginal(&f,stream,n,&i);
     }
-    return time_str;
+    return benchTime(&t0);
 }
 
-/* Calculate difference in timestamps and add this to an avarage value. The
- * difference is returned.
+/* Inject faults into BENCH_FRAMES packets and feed them to frameByte() with
+ * resync, and to the framer of the original getViscaPacket() as `legacy`.
+ * Each fault type is run alone with its rate, then all together.
+ *
+ * - lost:   packets not received correctly, `intact` of them had no fault
+ * - false:  packets accepted (with terminator) which weren't sent this way
+ * - resync: from the first byte of a damaged packet to the next correct one,
+ *           as line time at 9600 baud
+ * - cost:   CPU time per fault, more than the same bytes without faults. It's
+ *           measured with a fault in each packet, the time of a few faults
+ *           is lost in the noise. The clean and the faulty stream are run
+ *           in turns BENCH_REPEAT times, the median of the differences
+ *           counts. ns/byte is the fastest clean run. The cost of the legacy
+ *           framer can be negative, it reads a truncated packet and the next
+ *           one in one call.
  */
-static long int addToAvarage ( const struct timeval *from, const struct timeval *to, T_Avarage *avg )
+static void benchFramer ( void )
 {
-    long int diff;
+    uint8_t *data, *length;
+    uint32_t *offset;
+    int16_t *clean;
+    T_BenchStream b, all;
+    T_VISCAInterface f;
+    T_Histogram h;
+    double rate[FAULT_MAX_TYPES], every[FAULT_MAX_TYPES], cost[BENCH_REPEAT], t_clean, t, x;
+    size_t size, i, j, c, r, correct, wrong;
+    int scenario, type, resync, k, m;
+    uint8_t rc;
 
-    if ( !from || !to || !avg )
+    data = malloc((size_t)BENCH_FRAMES*VISCA_MAX_SIZE);
+    offset = malloc(BENCH_FRAMES*sizeof(uint32_t));
+    length = malloc(BENCH_FRAMES);
+    clean = malloc((size_t)BENCH_FRAMES*VISCA_MAX_SIZE*sizeof(int16_t));
+    b.stream = malloc((size_t)BENCH_FRAMES*2*VISCA_MAX_SIZE*sizeof(int16_t));
+    b.start = malloc(BENCH_FRAMES*sizeof(uint32_t));
+    b.end = malloc(BENCH_FRAMES*sizeof(uint32_t));
+    b.id = malloc(BENCH_FRAMES*sizeof(uint32_t));
+    b.fault = malloc(BENCH_FRAMES*sizeof(uint32_t));
+    all.stream = malloc((size_t)BENCH_FRAMES*2*VISCA_MAX_SIZE*sizeof(int16_t));
+    all.start = malloc(BENCH_FRAMES*sizeof(uint32_t));
+    all.end = malloc(BENCH_FRAMES*sizeof(uint32_t));
+    all.id = malloc(BENCH_FRAMES*sizeof(uint32_t));
+    all.fault = malloc(BENCH_FRAMES*sizeof(uint32_t));
+    if ( !data || !offset || !length || !clean || !b.stream || !b.start || !b.end || !b.id || !b.fault
+         || !all.stream || !all.start || !all.end || !all.id || !all.fault )
     {
-        fputs("error: addToAvarage(): NULL parameter\n", stderr);
-        return 0.0;
-    }
-    if ( from->tv_sec > to->tv_sec )
-    {
-        fputs("error: addToAvarage(): 'from' later than 'to'\n", stderr);
-        return 0.0;
+        fputs("ERROR: benchFramer(): out of memory\n",stderr);
+        exit(1);
     }
-    diff = (long int)(to->tv_sec-from->tv_sec)*1000L+(long int)(to->tv_usec-from->tv_usec)/1000L;
-    if ( diff < AVG_OUTLIER )
+    size = benchPackets(data,offset,length,BENCH_FRAMES);
+    for ( i=0; i<size; i++ )
+        clean[i] = data[i];
+
+    for ( scenario=0; scenario<=FAULT_MAX_TYPES; scenario++ )
     {
-        avg->sum += (long double)diff;
-        avg->cnt++;
-        avg->current = avg->sum/avg->cnt;
+        for ( type=0; type<FAULT_MAX_TYPES; type++ )
+        {
+            rate[type] = (scenario == FAULT_MAX_TYPES || scenario == type) ? FaultRate[type] : 0.0;
+            every[type] = (rate[type] > 0.0) ? 1.0 : 0.0;
+        }
+        if ( scenario < FAULT_MAX_TYPES && rate[scenario] <= 0.0 )
+            continue;
+        benchFaults(&b,data,offset,length,rate);
+        benchFaults(&all,data,offset,length,every);
+
+        for ( resync=0; resync<=1; resync++ )
+        {
+            t_clean = 1e9;
+            for ( k=0; k<BENCH_REPEAT; k++ )
+            {
+                t = benchFrameBytes(clean,size,resync);
+                x = (benchFrameBytes(all.stream,all.n,resync) - t*all.n/size)*1e9/all.faults;
+                for ( m=k; m>0 && cost[m-1]>x; m-- )    // sorted
+                    cost[m] = cost[m-1];
+                cost[m] = x;
+                if ( t < t_clean )
+                    t_clean = t;
+            }
+
+            /* check the received packets
+             */
+            memset(&f,0,sizeof(f));
+            memset(&h,0,sizeof(h));
+            correct = wrong = 0;
+            for ( j=c=r=0; j<b.n; )
+            {
+                if ( resync )
+                    rc = frameByte(&f,b.stream[j++]);
+                else
+                    rc = benchOriginal(&f,b.stream,b.n,&j);
+                if ( rc != VISCA_SUCCESS )
+                    continue;
+                i = j-1;                            // the terminator
+                while ( c < b.intact && b.end[c] < i )
+                    c++;
+                if ( c < b.intact && b.end[c] == i && f.num == length[b.id[c]]
+                     && memcmp(f.buffer,data+offset[b.id[c]],f.num) == 0 )
+                {
+                    correct++;
+                    for ( ; r < b.faults && b.fault[r] <= b.start[c]; r++ )
+                        histAdd(&h,(long)(b.start[c]-b.fault[r])*VISCA_BYTE_TIME/1000);
+                }
+                else if ( f.num >= VISCA_MIN_SIZE )
+                    wrong++;
+            }
+            printf("framer %-8s %-6s: %zu faults | lost=%zu intact=%zu | false=%zu | resync p50/p99=%ld/%ld [ms] | %.1f ns/byte cost %.1f ns/fault\n",
+                   scenario<FAULT_MAX_TYPES?FaultNames[scenario]:"all",resync?"resync":"legacy",
+                   b.faults,BENCH_FRAMES-correct,b.intact-correct,wrong,
+                   histPercentile(&h,50),histPercentile(&h,99),
+                   t_clean*1e9/size,cost[BENCH_REPEAT/2]);
+        }
     }
-    else
+    free(data); free(offset); free(length); free(clean);
+    free(b.stream); free(b.start); free(b.end); free(b.id); free(b.fault);
+    free(all.stream); free(all.start); free(all.end); free(all.id); free(all.fault);
+}
+
+/* Write BENCH_RECORDS records to a capture file in the current directory and
+ * measure the time spent by the capture thread for each record. The records
+ * are written as fast as possible, so in the direct mode the capture thread
+ * waits for the writer if the disk is slower. The maximum contains the
+ * preemption by other threads and these waits.
+ */
+static void benchCapture ( bool direct )
+{
+    static const uint8_t packet[] = { 0x81, 0x01, 0x04, 0x07, 0x02, 0xFF };
+    const char *FileName = "visca-dump-bench.cap";
+    struct timespec start, t0, t1;
+    struct timeval tick;
+    T_Histogram h;
+    T_Capture *cap;
+    double total;
+    long ns, max = 0;
+    int i;
+
+    cap = openCapture(FileName,direct);
+    if ( !cap )
+        return;
+    memset(&h,0,sizeof(h));
+    gettimeofday(&tick,NULL);
+    clock_gettime(CLOCK_MONOTONIC,&start);
+    for ( i=0; i<BENCH_RECORDS; i++ )
     {
-        fputs("error: addToAvarage(): skip outlier\n", stderr);
+        clock_gettime(CLOCK_MONOTONIC,&t0);
+        writeCapture(cap,i&1,VISCA_SUCCESS,&tick,packet,sizeof(packet),0);
+        clock_gettime(CLOCK_MONOTONIC,&t1);
+        ns = (t1.tv_sec-t0.tv_sec)*1000000000L + (t1.tv_nsec-t0.tv_nsec);
+        histAdd(&h,ns);                 // [ns], the overflow is >= 4096ns
+        if ( ns > max )
+            max = ns;
     }
-    return diff;
+    total = benchTime(&start);
+    printf("capture %-8s: %d records | %.0f records/s | %.1f MB/s | write p99/p99.9 %ld/%ld [ns] max %ld [us] | dropped=%ld waits=%ld"
+           " | fdatasync max %ld [us]\n",
+           direct?"direct":"buffered",BENCH_RECORDS,BENCH_RECORDS/total,
+           (double)cap->blocks*CAPTURE_BLOCK/total/1e6,
+           histPercentile(&h,99),histPercentile(&h,99.9),max/1000,cap->dropped,cap->waits,(long)cap->stall);
+    closeCapture(cap);
+    unlink(FileName);
 }
 
 /* Parse the command line arguments.
@@ -794,10 +8389,176 @@ static bool parseArguments ( int argc, char *argv[] )
 {
     int Done = 0;
     optind = 1;   /* start without prog-name */
+    compileTemplate(&Render,RENDER_DEFAULT);
     do
     {
-        switch ( getopt(argc, argv, "lDht:r:s:") )
+        switch ( getopt(argc, argv, "lDBWPVKht:r:O:s:S:C:F:L:N:R:q:w:i:I:d:x:X:T:H:M:Q:") )
         {
+            case 'T':
+                if ( optarg && !compileTemplate(&Render,optarg) )
+                {
+                    fputs("error: invalid column template for -T\n",stderr);
+                    return false;
+                }
+                break;
+            case 'x':
+                if ( optarg )
+                {
+                    strncpy(ScriptFileName, optarg, FILENAME_MAX-1);
+                    fprintf(stderr, "info: script `%s'\n", ScriptFileName);
+                }
+                break;
+            case 'X':
+                if ( optarg )
+                {
+                    if ( !parseScriptBudget(optarg) )
+                    {
+                        fputs("error: invalid budget for -X\n",stderr);
+                        return false;
+                    }
+                }
+                break;
+            case 'w':
+                if ( optarg )
+                {
+                    strncpy(CaptureFileName, optarg, FILENAME_MAX-1);
+                    fprintf(stderr, "info: capture file `%s'\n", CaptureFileName);
+                }
+                break;
+            case 'W':
+                CaptureDirect = true;
+                break;
+            case 'K':
+                ReplayCache = true;
+                break;
+            case 'H':
+                if ( optarg )
+                {
+                    strncpy(ReportFileName, optarg, FILENAME_MAX-1);
+                    fprintf(stderr, "info: report `%s'\n", ReportFileName);
+                }
+                break;
+            case 'M':
+                if ( optarg )
+                {
+                    strncpy(HintFileName, optarg, FILENAME_MAX-1);
+                    fprintf(stderr, "info: latency hints `%s'\n", HintFileName);
+                }
+                break;
+            case 'i':
+                if ( optarg )
+                {
+                    strncpy(ReplayFileName, optarg, FILENAME_MAX-1);
+                    fprintf(stderr, "info: replay capture file `%s'\n", ReplayFileName);
+                }
+                break;
+            case 'I':
+                if ( optarg )
+                {
+                    strncpy(ImportFileName, optarg, FILENAME_MAX-1);
+                    fprintf(stderr, "info: import log `%s'\n", ImportFileName);
+                }
+                break;
+            case 'd':
+                if ( optarg )
+                {
+                    strncpy(ImportDate, optarg, sizeof(ImportDate)-1);
+                }
+                break;
+            case 'B':
+                Benchmark = true;
+                break;
+            case 'O':
+                if ( optarg && !parseSlo(optarg) )
+                {
+                    fputs("error: invalid objective for -O\n",stderr);
+                    return false;
+                }
+                break;
+            case 'N':
+                if ( optarg && !parseFaults(optarg) )
+                {
+                    fputs("error: invalid faults for -N\n",stderr);
+                    return false;
+                }
+                break;
+            case 'P':
+                Proxy = true;
+                fputs("info: proxy mode\n", stderr);
+                break;
+            case 'V':
+                AskVersion = true;
+                break;
+            case 'C':
+                if ( optarg )
+                {
+                    CacheTTL=atol(optarg);
+                    if ( CacheTTL<=0 )
+                    {
+                        fputs("error: invalid time for -C\n",stderr);
+                        return false;
+                    }
+                }
+                break;
+            case 'F':
+                if ( optarg )
+                {
+                    PrefetchCap=atol(optarg);
+                    if ( PrefetchCap<=0 || PrefetchCap>100 )
+                    {
+                        fputs("error: invalid percentage for -F\n",stderr);
+                        return false;
+                    }
+                }
+                break;
+            case 'L':
+                if ( optarg )
+                {
+                    PaceCeiling=atol(optarg);
+                    if ( PaceCeiling<=0 )
+                    {
+                        fputs("error: invalid latency for -L\n",stderr);
+                        return false;
+                    }
+                }
+                break;
+            case 'Q':
+                if ( optarg )
+                {
+                    ReaderWatermark=atol(optarg);
+                    if ( ReaderWatermark<=0 )
+                    {
+                        fputs("error: invalid watermark for -Q\n",stderr);
+                        return false;
+                    }
+                }
+                break;
+            case 'S':
+                if ( optarg )
+                {
+                    strncpy(ShadowPortName, optarg, V24_SZ_PORTNAME);
+                    ShadowPortName[V24_SZ_PORTNAME] = '\0';
+                    fprintf(stderr, "info: shadow port `%s'\n", ShadowPortName);
+                }
+                break;
+            case 'R':
+                if ( optarg )
+                {
+                    strncpy(RrdFileName, optarg, FILENAME_MAX-1);
+                    fprintf(stderr, "info: store `%s'\n", RrdFileName);
+                }
+                break;
+            case 'q':
+                if ( optarg )
+                {
+                    RrdQuery=atol(optarg);
+                    if ( RrdQuery<=0 )
+                    {
+                        fputs("error: invalid range for -q\n",stderr);
+                        return false;
+                    }
+                }
+                break;
             case 'r':
                 if ( optarg )
                 {
@@ -851,6 +8612,70 @@ static bool parseArguments ( int argc, char *argv[] )
     return true;
 }
 
+/* Parse the fault rates "type=rate,...". Types not listed keep their rate.
+ */
+static bool parseFaults ( const char *spec )
+{
+    char *end;
+    int i;
+    size_t len;
+
+    while ( *spec )
+    {
+        for ( i=0; i<FAULT_MAX_TYPES; i++ )
+        {
+            len = strlen(FaultNames[i]);
+            if ( strncmp(spec,FaultNames[i],len) == 0 && spec[len] == '=' )
+                break;
+        }
+        if ( i >= FAULT_MAX_TYPES )
+            return false;
+        FaultRate[i] = strtod(spec+len+1,&end);
+        if ( end == spec+len+1 || FaultRate[i] < 0.0 || FaultRate[i] > 1.0 || (*end != ',' && *end != '\0') )
+            return false;
+        spec = (*end == ',') ? end+1 : end;
+    }
+    return true;
+}
+
+/* Parse the budgets of the script hooks: "us" for all hooks, or
+ * "event=us,..." (packet, transaction, interval). Hooks not listed keep
+ * their budget.
+ */
+static bool parseScriptBudget ( const char *spec )
+{
+    char *end;
+    long budget;
+    int i;
+    size_t len;
+
+    budget = strtol(spec,&end,10);
+    if ( end != spec && *end == '\0' )
+    {
+        if ( budget <= 0 )
+            return false;
+        for ( i=0; i<SCRIPT_MAX_EVENTS; i++ )
+            ScriptBudget[i] = budget;
+        return true;
+    }
+    while ( *spec )
+    {
+        for ( i=0; i<SCRIPT_MAX_EVENTS; i++ )
+        {
+            len = strlen(ScriptEventNames[i]);
+            if ( strncmp(spec,ScriptEventNames[i],len) == 0 && spec[len] == '=' )
+                break;
+        }
+        if ( i >= SCRIPT_MAX_EVENTS )
+            return false;
+        ScriptBudget[i] = strtol(spec+len+1,&end,10);
+        if ( end == spec+len+1 || ScriptBudget[i] <= 0 || (*end != ',' && *end != '\0') )
+            return false;
+        spec = (*end == ',') ? end+1 : end;
+    }
+    return true;
+}
+
 static void usage ( void )
 {
     fprintf(stderr, "SYNOPSIS\n");
@@ -863,8 +8688,31 @@ static void usage ( void )
     fprintf(stderr, "-r dev\tserial port <dev> connected to the receiver (camera).\n");
     fprintf(stderr, "-s dev\tserial port <dev> connected to the sender (controller).\n");
     fprintf(stderr, "-t sec\tset timeout to <sec> seconds.\n");
+    fprintf(stderr, "-Q bytes\twarn if more than <bytes> are queued in the kernel for a port\n\t(default %d).\n",READER_WATERMARK);
     fprintf(stderr, "-l\tV24: lock the serial port.\n");
     fprintf(stderr, "-D\tV24: enable debugging.\n");
+    fprintf(stderr, "-R file\tkeep the interval statistics in the round robin store <file>.\n");
+    fprintf(stderr, "-q sec\tquery the last <sec> seconds from the store (needs -R).\n");
+    fprintf(stderr, "-w file\twrite all packets to the capture <file>.\n");
+    fprintf(stderr, "-W\twrite the capture with O_DIRECT by a background thread.\n");
+    fprintf(stderr, "-i file\treplay the capture <file> instead of using serial ports.\n");
+    fprintf(stderr, "-K\tcache the analysis of the replayed blocks in <file>%s, only new\n\tor changed blocks are analysed, and only new blocks are merged into\n\tthe store again (needs -i and -R).\n",PARTIALS_SUFFIX);
+    fprintf(stderr, "-M file\tpublish the latency hints per camera in a shared memory table\n\t<file> (e.g. /dev/shm/visca-hints), updated on every transaction.\n");
+    fprintf(stderr, "-H file\twrite an HTML report of the capture to <file> (needs -i). With\n\t-q, the last <sec> seconds of the capture are reported.\n");
+    fprintf(stderr, "-I file\timport the text log <file> of visca-dump into the capture (needs -w).\n");
+    fprintf(stderr, "-d date\tfirst day YYYY-MM-DD of the imported log (default: counted back\n\tfrom the modification time).\n");
+    fprintf(stderr, "-T tmpl\tcolumn template of the packet lines (default `%s').\n\tColumns: %%t time, %%e epoch, %%n line, %%h hex (padded), %%x hex,\n\t%%l length, %%a address, %%s socket, %%p parameter, %%d reply times,\n\t%%c command. A width like %%20c pads the column, %%%% is a `%%'.\n",RENDER_DEFAULT);
+    fprintf(stderr, "-x file\trun the Lua analysis script <file>.\n");
+    fprintf(stderr, "-X us\tCPU time budget of a script hook call in [us] (default %d), for all\n\thooks or per event, e.g. `packet=50,transaction=200'.\n",SCRIPT_BUDGET);
+    fprintf(stderr, "-P\tproxy mode: forward the packets between sender and receiver.\n");
+    fprintf(stderr, "-V\tsend a VersionInq to each camera (needs -P).\n");
+    fprintf(stderr, "-C ms\tanswer inquiries from replies not older than <ms> (needs -P).\n");
+    fprintf(stderr, "-F pct\tprefetch cached inquiries in idle time, using at most <pct>%% of the line (needs -C).\n");
+    fprintf(stderr, "-L ms\tpace the commands per camera, so the p99 of the replies stays below\n\t<ms> (needs -P).\n");
+    fprintf(stderr, "-O slo\tservice level objective `class[@cam]:ack|done:pNN<ms', e.g.\n\t`stop:ack:p99<50'. class: all, cmd, inq, stop or a command name.\n\tUp to %d objectives.\n",SLO_MAX);
+    fprintf(stderr, "-S dev\tcopy the controller packets to a shadow camera at <dev> (needs -P).\n");
+    fprintf(stderr, "-B\trun the benchmarks (no serial port is used).\n");
+    fprintf(stderr, "-N spec\tfaults per packet of the framer benchmark, e.g. `flip=0.01,gap=0'\n\t(flip, drop, spurious, truncate, gap; default %g each).\n",BENCH_FAULT_RATE);
 }
 
 
@@ -877,10 +8725,20 @@ static void installSignalhandler ( void )
 
 static void mySignalHandler ( int reason )
 {
+    /* The first signal terminates the main loop, so the capture file and the
+     * store are closed properly. A second one aborts.
+     */
+    if ( !Terminate )
+    {
+        Terminate = 1;
+        return;
+    }
     if ( sender.uart )
         v24ClosePort(sender.uart);
     if ( receiver.uart )
         v24ClosePort(receiver.uart);
+    if ( shadow.uart )
+        v24ClosePort(shadow.uart);
     fprintf(stderr,"**ABORT**\n");
     exit(99);
 }